@@ -12,10 +12,15 @@
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
+//
+// Buffers come from a slab cache as needed, up to a maximum
+// that grows with the amount of physical memory; after that,
+// a miss recycles the least recently used free buffer.
 
 
 #include "types.h"
 #include "param.h"
+#include "memlayout.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "riscv.h"
@@ -23,9 +28,14 @@
 #include "fs.h"
 #include "buf.h"
 
+#define NBBUCKET 251
+
 struct {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct buf *bucket[NBBUCKET];  // hash chains, through hnext
+  struct kmem_cache *cache;
+  int n;               // buffers allocated from cache
+  int max;             // most buffers to allocate
 
   // Linked list of all buffers, through prev/next.
   // Sorted by how recently the buffer was used.
@@ -36,56 +46,104 @@ struct {
 void
 binit(void)
 {
-  struct buf *b;
-
-  initlock(&bcache.lock, "bcache");
+  initticketlock(&bcache.lock, "bcache");
 
-  // Create linked list of buffers
   bcache.head.prev = &bcache.head;
   bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+  // at most 1/256 of memory holds cached blocks.
+  bcache.max = (physend - KERNBASE) / 256 / BSIZE;
+  if(bcache.max < NBUF)
+    bcache.max = NBUF;
+  bcache.cache = kmem_cache_create("buf", sizeof(struct buf));
+}
+
+static struct buf**
+bbucket(uint dev, uint blockno)
+{
+  return &bcache.bucket[(dev * 31 + blockno) % NBBUCKET];
+}
+
+// Remove b from its hash chain, if it's on one.
+// Caller must hold bcache.lock.
+static void
+bunhash(struct buf *b)
+{
+  struct buf **pp;
+
+  for(pp = bbucket(b->dev, b->blockno); *pp; pp = &(*pp)->hnext){
+    if(*pp == b){
+      *pp = b->hnext;
+      return;
+    }
   }
 }
 
+// Read or write b on the disk that holds it:
+// the ramdisk if the kernel booted with one.
+static void
+brw(struct buf *b, int write)
+{
+  if(ramdiskused())
+    ramdiskrw(b, write);
+  else
+    virtio_disk_rw(b, write);
+}
+
 // Look through buffer cache for block on device dev.
 // If not found, allocate a buffer.
-// In either case, return locked buffer.
+// In either case, return locked buffer, locked
+// shared if shared is set.
 static struct buf*
-bget(uint dev, uint blockno)
+bget(uint dev, uint blockno, int shared)
 {
   struct buf *b;
 
   acquire(&bcache.lock);
 
   // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+  for(b = *bbucket(dev, blockno); b; b = b->hnext){
     if(b->dev == dev && b->blockno == blockno){
       b->refcnt++;
       release(&bcache.lock);
-      acquiresleep(&b->lock);
+      if(shared)
+        acquiresleepshared(&b->lock);
+      else
+        acquiresleep(&b->lock);
       return b;
     }
   }
 
   // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
-    }
+  // Use a new buffer if there's room for one, or else
+  // recycle the least recently used (LRU) unused buffer.
+  if(bcache.n < bcache.max && (b = kmem_cache_alloc(bcache.cache)) != 0){
+    bcache.n++;
+    memset(b, 0, sizeof(*b));
+    initsleeplock(&b->lock, "buffer");
+    b->next = bcache.head.next;
+    b->prev = &bcache.head;
+    bcache.head.next->prev = b;
+    bcache.head.next = b;
+  } else {
+    for(b = bcache.head.prev; b != &bcache.head; b = b->prev)
+      if(b->refcnt == 0)
+        break;
+    if(b == &bcache.head)
+      panic("bget: no buffers");
+    bunhash(b);
   }
-  panic("bget: no buffers");
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 1;
+  b->hnext = *bbucket(dev, blockno);
+  *bbucket(dev, blockno) = b;
+  release(&bcache.lock);
+  if(shared)
+    acquiresleepshared(&b->lock);
+  else
+    acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -94,33 +152,54 @@ bread(uint dev, uint blockno)
 {
   struct buf *b;
 
-  b = bget(dev, blockno);
+  b = bget(dev, blockno, 0);
   if(!b->valid) {
-    virtio_disk_rw(b, 0);
+    brw(b, 0);
     b->valid = 1;
   }
   return b;
 }
 
+// Like bread(), but the buffer is locked shared, so
+// other readers of the same block need not wait.
+// The caller must not modify it, and must release
+// it with brelseshared().
+struct buf*
+breadshared(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno, 1);
+  if(!b->valid) {
+    // only one process should read it from disk.
+    // b->refcnt keeps the buffer from being recycled
+    // while it's unlocked.
+    releasesleepshared(&b->lock);
+    acquiresleep(&b->lock);
+    if(!b->valid) {
+      brw(b, 0);
+      b->valid = 1;
+    }
+    releasesleep(&b->lock);
+    acquiresleepshared(&b->lock);
+  }
+  return b;
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
 {
   if(!holdingsleep(&b->lock))
     panic("bwrite");
-  virtio_disk_rw(b, 1);
+  brw(b, 1);
 }
 
-// Release a locked buffer.
+// Drop a reference to an unlocked buffer.
 // Move to the head of the most-recently-used list.
-void
-brelse(struct buf *b)
+static void
+bput(struct buf *b)
 {
-  if(!holdingsleep(&b->lock))
-    panic("brelse");
-
-  releasesleep(&b->lock);
-
   acquire(&bcache.lock);
   b->refcnt--;
   if (b->refcnt == 0) {
@@ -136,6 +215,28 @@ brelse(struct buf *b)
   release(&bcache.lock);
 }
 
+// Release a locked buffer.
+void
+brelse(struct buf *b)
+{
+  if(!holdingsleep(&b->lock))
+    panic("brelse");
+
+  releasesleep(&b->lock);
+  bput(b);
+}
+
+// Release a buffer from breadshared().
+void
+brelseshared(struct buf *b)
+{
+  if(!holdingsleepshared(&b->lock))
+    panic("brelseshared");
+
+  releasesleepshared(&b->lock);
+  bput(b);
+}
+
 void
 bpin(struct buf *b) {
   acquire(&bcache.lock);
@@ -4,15 +4,23 @@ struct file;
 struct inode;
 struct pipe;
 struct proc;
+struct ringsqe;
 struct spinlock;
 struct sleeplock;
 struct stat;
+struct dcachestat;
+struct lockstat;
+struct slabstat;
+struct memstat;
+struct kmem_cache;
 struct superblock;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
 void            brelse(struct buf*);
+struct buf*     breadshared(uint, uint);
+void            brelseshared(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
@@ -24,6 +32,7 @@ void            consputc(int);
 
 // exec.c
 int             exec(char*, char**);
+int             execproc(struct proc*, char*, char**);
 
 // file.c
 struct file*    filealloc(void);
@@ -34,16 +43,27 @@ int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
 
+// fdt.c
+void            fdtinit(void);
+int             fdtinitrd(uint64*, uint64*);
+extern uint64   physend;
+
 // fs.c
 void            fsinit(int);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+void            dirunlink(struct inode*, char*, uint);
+int             dirinit(struct inode*, uint);
+int             dirempty(struct inode*);
+void            dcachestat(struct dcachestat*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
 void            ilock(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
+void            ilockshared(struct inode*);
+void            iunlockshared(struct inode*);
 void            iunlockput(struct inode*);
 void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
@@ -53,16 +73,23 @@ int             readi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
+int             mount(struct inode*);
+int             mounted(struct inode*);
 
 // ramdisk.c
-void            ramdiskinit(void);
-void            ramdiskintr(void);
-void            ramdiskrw(struct buf*);
+int             ramdiskinit(void);
+int             ramdiskused(void);
+void            ramdiskrw(struct buf*, int);
+void            ramdisktrim(uint);
 
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
+void*           kallocorder(int);
+void            kfreeorder(void*, int);
 void            kinit(void);
+void            freerange(void*, void*);
+void            kmemstat(struct memstat*);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -71,25 +98,35 @@ void            begin_op(void);
 void            end_op(void);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
 int             pipewrite(struct pipe*, uint64, int);
 
+// ring.c
+void            ringfree(struct proc*);
+
 // printf.c
 void            printf(char*, ...);
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
 
+// prof.c
+void            profinit(void);
+int             proftick(void);
+
 // proc.c
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
+int             spawn(char*, char**, struct file**);
 int             growproc(int);
-void            proc_mapstacks(pagetable_t);
+void            asidflush(struct proc*);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kill(int);
+int             procsyscallstat(int, int, uint64*, uint64*);
 struct cpu*     mycpu(void);
 struct cpu*     getmycpu(void);
 struct proc*    myproc();
@@ -98,7 +135,9 @@ void            scheduler(void) __attribute__((noreturn));
 void            sched(void);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
+void            kthread(char*, void (*)(void));
 int             wait(uint64);
+int             waitpid(int, uint64, int);
 void            wakeup(void*);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
@@ -108,24 +147,74 @@ void            procdump(void);
 // swtch.S
 void            swtch(struct context*, struct context*);
 
+// copyuser.S
+int             copyuser(void*, const void*, uint64);
+int             copyuserstr(char*, const char*, uint64);
+
+// sysfile.c
+int             ringop(struct ringsqe*);
+
+// tmpfs.c
+void            tmpfsinit(void);
+int             istmp(uint);
+int             tmpfsalloc(void);
+void            tmpfsfree(uint);
+uint            tmpinum(uint, int);
+void            tmpifree(uint, uint);
+int             tmpread(struct inode*, int, uint64, uint, uint);
+int             tmpwrite(struct inode*, int, uint64, uint, uint);
+void            tmptrunc(struct inode*);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initticketlock(struct spinlock*, char*);
+void            freelock(struct spinlock*);
+int             lockstat(int, struct lockstat*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
+// slab.c
+void            slabinit(void);
+struct kmem_cache* kmem_cache_create(char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+void*           kmalloc(uint);
+void            kmfree(void*);
+int             slabstat(int, struct slabstat*);
+
+// swap.c
+void            swapinit(void);
+void            swapon(uint, struct superblock*);
+void            vmlock(struct proc*);
+void            vmunlock(struct proc*);
+int             swapout(void);
+void*           swapalloc(void);
+int             swapin(pagetable_t, uint64);
+void            swapread(int, char*);
+void            slotfree(int);
+void            swappin(uint64, uint64);
+void            swapunpin(void);
+void            swapd(void);
+void            swapstat(struct memstat*);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
+void            acquiresleepshared(struct sleeplock*);
+void            releasesleepshared(struct sleeplock*);
+int             holdingsleepshared(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
 // string.c
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
 void*           memset(void*, int, uint);
+void            pgzero(void*);
+void            pgcopy(void*, const void*);
 char*           safestrcpy(char*, const char*, int);
 int             strlen(const char*);
 int             strncmp(const char*, const char*, uint);
@@ -150,13 +239,19 @@ void            usertrapret(void);
 void            uartinit(void);
 void            uartintr(void);
 void            uartputc(int);
+int             uartwrite(int, uint64, int);
 void            uartputc_sync(int);
 int             uartgetc(void);
 
 // vm.c
 void            kvminit(void);
 void            kvminithart(void);
+int             kvmasids(void);
+void            kvmswitch(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
+pagetable_t     kvmcreate(void);
+void            kvmsync(pagetable_t, pagetable_t);
+void            kvmfree(pagetable_t);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 void            uvminit(pagetable_t, uchar *, uint);
@@ -166,6 +261,8 @@ int             uvmcopy(pagetable_t, pagetable_t, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
+int             uvmsplit(pagetable_t, uint64);
+pte_t*          walk(pagetable_t, uint64, int);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
@@ -11,6 +11,15 @@ static int loadseg(pde_t *pgdir, uint64 addr, struct inode *ip, uint offset, uin
 
 int
 exec(char *path, char **argv)
+{
+  return execproc(myproc(), path, argv);
+}
+
+// Replace p's user memory with the program at path.
+// p is the current process, or a new one from spawn()
+// that hasn't run yet. Returns argc, or -1 on error.
+int
+execproc(struct proc *p, char *path, char **argv)
 {
   char *s, *last;
   int i, off;
@@ -19,7 +28,6 @@ exec(char *path, char **argv)
   struct inode *ip;
   struct proghdr ph;
   pagetable_t pagetable = 0, oldpagetable;
-  struct proc *p = myproc();
 
   begin_op();
 
@@ -27,7 +35,8 @@ exec(char *path, char **argv)
     end_op();
     return -1;
   }
-  ilock(ip);
+  // other processes may be running the same program.
+  ilockshared(ip);
 
   // Check ELF header
   if(readi(ip, 0, (uint64)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -48,6 +57,8 @@ exec(char *path, char **argv)
       goto bad;
     if(ph.vaddr + ph.memsz < ph.vaddr)
       goto bad;
+    if(ph.vaddr + ph.memsz > MAXUSER)
+      goto bad;
     uint64 sz1;
     if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz)) == 0)
       goto bad;
@@ -57,17 +68,19 @@ exec(char *path, char **argv)
     if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
       goto bad;
   }
-  iunlockput(ip);
+  iunlockshared(ip);
+  iput(ip);
   end_op();
   ip = 0;
 
-  p = myproc();
   uint64 oldsz = p->sz;
 
   // Allocate two pages at the next page boundary.
   // Use the second as the user stack.
   sz = PGROUNDUP(sz);
   uint64 sz1;
+  if(sz + 2*PGSIZE > MAXUSER)
+    goto bad;
   if((sz1 = uvmalloc(pagetable, sz, sz + 2*PGSIZE)) == 0)
     goto bad;
   sz = sz1;
@@ -108,13 +121,22 @@ exec(char *path, char **argv)
       last = s+1;
   safestrcpy(p->name, last, sizeof(p->name));
     
+  // The system call ring does not survive exec.
+  ringfree(p);
+
   // Commit to the user image.
+  vmlock(p);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  // switch the kernel's view of user memory before
+  // the old page table's pages go away.
+  kvmsync(p->kpagetable, pagetable);
+  asidflush(p);
   proc_freepagetable(oldpagetable, oldsz);
+  vmunlock(p);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
@@ -122,7 +144,8 @@ exec(char *path, char **argv)
   if(pagetable)
     proc_freepagetable(pagetable, sz);
   if(ip){
-    iunlockput(ip);
+    iunlockshared(ip);
+    iput(ip);
     end_op();
   }
   return -1;
@@ -0,0 +1,164 @@
+//
+// Read the flattened device tree that qemu passes
+// at boot, for what the kernel can't know ahead of time:
+// how much RAM there is (qemu -m), and where qemu -initrd
+// put the disk image.
+// The format is described in the devicetree spec,
+// chapter 5; all numbers in it are big-endian.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "defs.h"
+
+#define FDT_MAGIC      0xd00dfeed
+#define FDT_BEGIN_NODE 1
+#define FDT_END_NODE   2
+#define FDT_PROP       3
+#define FDT_NOP        4
+#define FDT_END        9
+
+struct fdtheader {
+  uint magic;
+  uint totalsize;
+  uint off_dt_struct;
+  uint off_dt_strings;
+  uint off_mem_rsvmap;
+  uint version;
+  uint last_comp_version;
+  uint boot_cpuid_phys;
+  uint size_dt_strings;
+  uint size_dt_struct;
+};
+
+extern uint64 fdtaddr;  // from start.c
+
+// what fdtinit() found.
+static struct {
+  uint64 initrdstart, initrdend;  // qemu -initrd image, or 0
+  uint64 memend;                  // end of the RAM at KERNBASE, or 0
+} fdt;
+
+// end of physical memory; see memlayout.h.
+uint64 physend = PHYSTOP;
+
+static uint
+be32(void *p)
+{
+  uchar *b = p;
+  return (uint)b[0] << 24 | b[1] << 16 | b[2] << 8 | b[3];
+}
+
+// A 32- or 64-bit property value.
+static uint64
+propval(uchar *p, uint len)
+{
+  if(len == 8)
+    return (uint64)be32(p) << 32 | be32(p + 4);
+  return be32(p);
+}
+
+// A number of n 32-bit cells.
+static uint64
+cells(uchar *p, int n)
+{
+  uint64 v = 0;
+
+  while(n-- > 0){
+    v = v << 32 | be32(p);
+    p += 4;
+  }
+  return v;
+}
+
+// Look through a memory node's reg property, len bytes of
+// (address, size) pairs, for the region holding the kernel.
+static void
+memreg(uchar *p, uint len, int acells, int scells)
+{
+  uchar *e = p + len;
+  uint64 addr, size;
+
+  while(p + 4*(acells + scells) <= e){
+    addr = cells(p, acells);
+    size = cells(p + 4*acells, scells);
+    p += 4*(acells + scells);
+    if(addr <= KERNBASE && KERNBASE < addr + size)
+      fdt.memend = addr + size;
+  }
+}
+
+// Walk the device tree. Must run before kinit(), which
+// may reuse the memory it and the initrd are in.
+void
+fdtinit(void)
+{
+  struct fdtheader *h = (struct fdtheader*)fdtaddr;
+  uchar *p, *strings;
+  char *name;
+  uint tok, len;
+  int depth = 0, inchosen = 0, inmemory = 0;
+  int acells = 2, scells = 1;  // the spec's defaults
+
+  if(h == 0 || be32(&h->magic) != FDT_MAGIC)
+    return;
+  p = (uchar*)h + be32(&h->off_dt_struct);
+  strings = (uchar*)h + be32(&h->off_dt_strings);
+
+  for(;;){
+    tok = be32(p);
+    p += 4;
+    if(tok == FDT_BEGIN_NODE){
+      name = (char*)p;
+      depth++;
+      inchosen = depth == 2 && strncmp(name, "chosen", 7) == 0;
+      inmemory = depth == 2 && strncmp(name, "memory", 6) == 0 &&
+        (name[6] == 0 || name[6] == '@');
+      p += (strlen(name) + 1 + 3) & ~3;
+    } else if(tok == FDT_END_NODE){
+      depth--;
+      inchosen = inmemory = 0;
+    } else if(tok == FDT_PROP){
+      len = be32(p);
+      name = (char*)strings + be32(p + 4);
+      p += 8;
+      if(inchosen && strncmp(name, "linux,initrd-start", 19) == 0)
+        fdt.initrdstart = propval(p, len);
+      if(inchosen && strncmp(name, "linux,initrd-end", 17) == 0)
+        fdt.initrdend = propval(p, len);
+      // the root's properties come before its children.
+      if(depth == 1 && strncmp(name, "#address-cells", 15) == 0)
+        acells = be32(p);
+      if(depth == 1 && strncmp(name, "#size-cells", 12) == 0)
+        scells = be32(p);
+      if(inmemory && strncmp(name, "reg", 4) == 0)
+        memreg(p, len, acells, scells);
+      p += (len + 3) & ~3;
+    } else if(tok == FDT_NOP){
+      continue;
+    } else {
+      break;  // FDT_END, or something unexpected
+    }
+  }
+
+  if(fdt.memend){
+    physend = fdt.memend;
+    if(physend > PHYSMAX)
+      physend = PHYSMAX;
+    physend = PGROUNDDOWN(physend);
+  }
+}
+
+// Where qemu -initrd loaded its image.
+// Returns 0 if there's none.
+int
+fdtinitrd(uint64 *start, uint64 *end)
+{
+  if(fdt.initrdstart == 0 || fdt.initrdend <= fdt.initrdstart)
+    return 0;
+  *start = fdt.initrdstart;
+  *end = fdt.initrdend;
+  return 1;
+}
@@ -14,15 +14,20 @@
 #include "proc.h"
 
 struct devsw devsw[NDEV];
+
+// File structures come from a slab cache, so the number of
+// open files is limited only by memory. ftable.lock protects
+// the ref counts.
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  struct kmem_cache *cache;
 } ftable;
 
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  ftable.cache = kmem_cache_create("file", sizeof(struct file));
 }
 
 // Allocate a file structure.
@@ -31,16 +36,11 @@ filealloc(void)
 {
   struct file *f;
 
-  acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
-  }
-  release(&ftable.lock);
-  return 0;
+  if((f = kmem_cache_alloc(ftable.cache)) == 0)
+    return 0;
+  memset(f, 0, sizeof(*f));
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -69,9 +69,8 @@ fileclose(struct file *f)
     return;
   }
   ff = *f;
-  f->ref = 0;
-  f->type = FD_NONE;
   release(&ftable.lock);
+  kmem_cache_free(ftable.cache, f);
 
   if(ff.type == FD_PIPE){
     pipeclose(ff.pipe, ff.writable);
@@ -91,9 +90,9 @@ filestat(struct file *f, uint64 addr)
   struct stat st;
   
   if(f->type == FD_INODE || f->type == FD_DEVICE){
-    ilock(f->ip);
+    ilockshared(f->ip);
     stati(f->ip, &st);
-    iunlock(f->ip);
+    iunlockshared(f->ip);
     if(copyout(p->pagetable, addr, (char *)&st, sizeof(st)) < 0)
       return -1;
     return 0;
@@ -101,6 +100,24 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
+// Read or write n bytes of user memory at addr from or to
+// pipe or device f. Pipes and devices copy while holding
+// spinlocks, when a page fault can't wait for swap, so
+// the memory is pinned; n should be at most a page.
+static int
+pinnedrw(struct file *f, uint64 addr, int n, int write)
+{
+  int r;
+
+  swappin(addr, n);
+  if(f->type == FD_PIPE)
+    r = write ? pipewrite(f->pipe, addr, n) : piperead(f->pipe, addr, n);
+  else
+    r = write ? devsw[f->major].write(1, addr, n) : devsw[f->major].read(1, addr, n);
+  swapunpin();
+  return r;
+}
+
 // Read from file f.
 // addr is a user virtual address.
 int
@@ -112,16 +129,27 @@ fileread(struct file *f, uint64 addr, int n)
     return -1;
 
   if(f->type == FD_PIPE){
-    r = piperead(f->pipe, addr, n);
+    r = pinnedrw(f, addr, n < PGSIZE ? n : PGSIZE, 0);
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].read)
       return -1;
-    r = devsw[f->major].read(1, addr, n);
+    r = pinnedrw(f, addr, n < PGSIZE ? n : PGSIZE, 0);
   } else if(f->type == FD_INODE){
-    ilock(f->ip);
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
-      f->off += r;
-    iunlock(f->ip);
+    // f->off needs the exclusive lock if other
+    // processes share f; otherwise only this process
+    // can be using it, so other readers of the inode
+    // may proceed alongside.
+    if(f->ref == 1){
+      ilockshared(f->ip);
+      if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
+        f->off += r;
+      iunlockshared(f->ip);
+    } else {
+      ilock(f->ip);
+      if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
+        f->off += r;
+      iunlock(f->ip);
+    }
   } else {
     panic("fileread");
   }
@@ -139,12 +167,23 @@ filewrite(struct file *f, uint64 addr, int n)
   if(f->writable == 0)
     return -1;
 
-  if(f->type == FD_PIPE){
-    ret = pipewrite(f->pipe, addr, n);
-  } else if(f->type == FD_DEVICE){
-    if(f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
+  if(f->type == FD_PIPE || f->type == FD_DEVICE){
+    if(f->type == FD_DEVICE &&
+       (f->major < 0 || f->major >= NDEV || !devsw[f->major].write))
       return -1;
-    ret = devsw[f->major].write(1, addr, n);
+    while(ret < n){
+      int n1 = n - ret;
+      if(n1 > PGSIZE)
+        n1 = PGSIZE;
+      if((r = pinnedrw(f, addr + ret, n1, 1)) < 0){
+        if(ret == 0)
+          ret = -1;
+        break;
+      }
+      ret += r;
+      if(r != n1)
+        break;
+    }
   } else if(f->type == FD_INODE){
     // write a few blocks at a time to avoid exceeding
     // the maximum log transaction size, including
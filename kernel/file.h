@@ -18,6 +18,8 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *next; // hash chain
+  struct inode *prev, *lrunext; // list of unreferenced inodes, if ref == 0
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -27,6 +29,9 @@ struct inode {
   short nlink;
   uint size;
   uint addrs[NDIRECT+1];
+
+  char **pages;       // tmpfs: page listing content pages
+  int pinned;         // tmpfs: holds a ref while nlink > 0
 };
 
 // map major device number to device functions.
@@ -7,12 +7,15 @@
 //
 // This file contains the low-level file system manipulation
 // routines.  The (higher-level) system call implementations
-// are in sysfile.c.
+// are in sysfile.c. Inodes on an in-memory tmpfs share the
+// inode table, directories, and names with the disk, but
+// keep their content in tmpfs.c.
 
 #include "types.h"
 #include "riscv.h"
 #include "defs.h"
 #include "param.h"
+#include "memlayout.h"
 #include "stat.h"
 #include "spinlock.h"
 #include "proc.h"
@@ -22,6 +25,20 @@
 #include "file.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
+static void dcacheinit(void);
+static void dcachepurge(uint, uint);
+static struct inode* mountdown(struct inode*);
+static struct inode* mountup(struct inode*);
+static int ismount(struct inode*);
+
+// Mounted tmpfs, indexed by dev - TMPDEV.
+struct {
+  struct spinlock lock;
+  struct mount {
+    struct inode *on;    // directory it's mounted on, or 0
+    struct inode *root;  // its root directory
+  } mount[NMOUNT];
+} mtable;
 // there should be one superblock per disk device, but we run with
 // only one device
 struct superblock sb; 
@@ -44,6 +61,7 @@ fsinit(int dev) {
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
   initlog(dev, &sb);
+  swapon(dev, &sb);
 }
 
 // Zero a block.
@@ -128,7 +146,7 @@ bfree(int dev, uint b)
 //   the reference and link counts have fallen to zero.
 //
 // * Referencing in table: an entry in the inode table
-//   is free if ip->ref is zero. Otherwise ip->ref tracks
+//   may be recycled if ip->ref is zero. Otherwise ip->ref tracks
 //   the number of in-memory pointers to the entry (open
 //   files and current directories). iget() finds or
 //   creates a table entry and increments its ref; iput()
@@ -138,7 +156,8 @@ bfree(int dev, uint b)
 //   table entry is only correct when ip->valid is 1.
 //   ilock() reads the inode from
 //   the disk and sets ip->valid, while iput() clears
-//   ip->valid if ip->ref has fallen to zero.
+//   ip->valid when it frees the inode, and iget() when
+//   it recycles the entry for a different inode.
 //
 // * Locked: file system code may only examine and modify
 //   the information in an inode and its content if it
@@ -162,18 +181,36 @@ bfree(int dev, uint b)
 // have locked the inodes involved; this lets callers create
 // multi-step atomic operations.
 //
-// The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// The table is hashed on (dev, inum). Each bucket's spin-lock
+// protects the hash chain and the ref, dev, and inum fields of
+// the entries on it, so lookups of different inodes don't
+// contend. An entry whose ref falls to zero stays hashed and
+// valid, so that it can be found again without reading the
+// disk, and goes on an LRU list protected by itable.lock; iget()
+// recycles the least recently used of these when the table has
+// reached its maximum size. Entries come from a slab cache as
+// needed, up to a maximum that grows with the amount of physical
+// memory. To avoid deadlock, never acquire a bucket
+// lock while holding itable.lock.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
+#define NIBUCKET 61
+
+struct ibucket {
+  struct spinlock lock;
+  struct inode *head;
+};
+
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct ibucket bucket[NIBUCKET];
+  struct inode lru;    // lru.lrunext is most recently used
+  struct kmem_cache *cache;
+  int n;               // entries allocated from cache
+  int max;             // most entries to allocate
 } itable;
 
 void
@@ -181,25 +218,141 @@ iinit()
 {
   int i = 0;
   
-  initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
+  initticketlock(&itable.lock, "itable");
+  for(i = 0; i < NIBUCKET; i++)
+    initlock(&itable.bucket[i].lock, "itable.bucket");
+  itable.lru.prev = &itable.lru;
+  itable.lru.lrunext = &itable.lru;
+  // about a page of inodes per 2MB of memory.
+  itable.max = (physend - KERNBASE) / 512 / sizeof(struct inode);
+  if(itable.max < NINODE)
+    itable.max = NINODE;
+  itable.cache = kmem_cache_create("inode", sizeof(struct inode));
+  dcacheinit();
+  initlock(&mtable.lock, "mtable");
+}
+
+static struct ibucket*
+ibucket(uint dev, uint inum)
+{
+  return &itable.bucket[(dev * 31 + inum) % NIBUCKET];
+}
+
+// Take ip off the LRU list. Caller must hold itable.lock.
+static void
+lruremove(struct inode *ip)
+{
+  ip->lrunext->prev = ip->prev;
+  ip->prev->lrunext = ip->lrunext;
+  ip->prev = ip->lrunext = 0;
+}
+
+// Remove ip from bucket b's hash chain.
+// Caller must hold b->lock.
+static void
+iunhash(struct ibucket *b, struct inode *ip)
+{
+  struct inode **pp;
+
+  for(pp = &b->head; *pp; pp = &(*pp)->next){
+    if(*pp == ip){
+      *pp = ip->next;
+      return;
+    }
+  }
+  panic("iunhash");
+}
+
+// Find an entry to hold a new inode: a new one from the
+// cache, or the least recently used unreferenced one.
+// Returns an entry that is on no list, or 0.
+// Caller must hold no bucket lock.
+static struct inode*
+inew(void)
+{
+  struct inode *ip;
+  struct ibucket *b;
+
+  acquire(&itable.lock);
+  if(itable.n < itable.max && (ip = kmem_cache_alloc(itable.cache)) != 0){
+    itable.n++;
+    release(&itable.lock);
+    memset(ip, 0, sizeof(*ip));
+    initsleeplock(&ip->lock, "inode");
+    return ip;
+  }
+
+  for(;;){
+    ip = itable.lru.prev;
+    if(ip == &itable.lru){
+      release(&itable.lock);
+      return 0;
+    }
+    // lock ip's bucket, then make sure that ip is still
+    // unreferenced and in that bucket.
+    b = ibucket(ip->dev, ip->inum);
+    release(&itable.lock);
+    acquire(&b->lock);
+    acquire(&itable.lock);
+    if(ip->prev != 0 && ibucket(ip->dev, ip->inum) == b){
+      lruremove(ip);
+      release(&itable.lock);
+      iunhash(b, ip);
+      release(&b->lock);
+      ip->next = 0;
+      return ip;
+    }
+    release(&b->lock);
   }
 }
 
+// Give back an entry from inew() that turned out not to be needed.
+static void
+iunnew(struct inode *ip)
+{
+  acquire(&itable.lock);
+  itable.n--;
+  release(&itable.lock);
+  freelock(&ip->lock.lk);
+  kmem_cache_free(itable.cache, ip);
+}
+
 static struct inode* iget(uint dev, uint inum);
 
 // Allocate an inode on device dev.
 // Mark it as allocated by  giving it type type.
-// Returns an unlocked but allocated and referenced inode.
+// Returns an unlocked but allocated and referenced inode,
+// or 0 if there are no free inodes.
 struct inode*
 ialloc(uint dev, short type)
 {
-  int inum;
+  static uint next = 1;  // where to start looking; only a hint
+  int i, inum;
   struct buf *bp;
   struct dinode *dip;
+  struct inode *ip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
+  if(istmp(dev)){
+    // nothing on disk: the in-memory inode is all there is.
+    // leave half the table for the disk's inodes, since
+    // linked tmpfs inodes stay in it.
+    if((inum = tmpinum(dev, itable.max / 2)) == 0)
+      return 0;
+    ip = iget(dev, inum);
+    ip->type = type;
+    ip->major = ip->minor = ip->nlink = 0;
+    ip->size = 0;
+    ip->valid = 1;
+    return ip;
+  }
+
+  // starting from just after the last inode allocated
+  // keeps a burst of creates from rescanning the
+  // inodes that are already in use.
+  inum = next;
+  for(i = 1; i < sb.ninodes; i++){
+    if(inum < 1 || inum >= sb.ninodes)
+      inum = 1;
     bp = bread(dev, IBLOCK(inum, sb));
     dip = (struct dinode*)bp->data + inum%IPB;
     if(dip->type == 0){  // a free inode
@@ -207,11 +360,14 @@ ialloc(uint dev, short type)
       dip->type = type;
       log_write(bp);   // mark it allocated on the disk
       brelse(bp);
+      next = inum + 1;
       return iget(dev, inum);
     }
     brelse(bp);
+    inum++;
   }
-  panic("ialloc: no inodes");
+  printf("ialloc: no inodes\n");
+  return 0;
 }
 
 // Copy a modified in-memory inode to disk.
@@ -224,6 +380,22 @@ iupdate(struct inode *ip)
   struct buf *bp;
   struct dinode *dip;
 
+  if(istmp(ip->dev)){
+    // a tmpfs inode must stay in the table while a directory
+    // links to it, so it holds a reference to itself until
+    // the last link goes; then iput() can free it as usual.
+    if(ip->nlink > 0 && !ip->pinned){
+      ip->pinned = 1;
+      idup(ip);
+    } else if(ip->nlink == 0 && ip->pinned){
+      ip->pinned = 0;
+      acquire(&ibucket(ip->dev, ip->inum)->lock);
+      ip->ref--;  // the caller's reference remains
+      release(&ibucket(ip->dev, ip->inum)->lock);
+    }
+    return;
+  }
+
   bp = bread(ip->dev, IBLOCK(ip->inum, sb));
   dip = (struct dinode*)bp->data + ip->inum%IPB;
   dip->type = ip->type;
@@ -242,32 +414,47 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
+  struct ibucket *b = ibucket(dev, inum);
   struct inode *ip, *empty;
 
-  acquire(&itable.lock);
-
-  // Is the inode already in the table?
   empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
-      ip->ref++;
-      release(&itable.lock);
-      return ip;
+  acquire(&b->lock);
+  for(;;){
+    // Is the inode already in the table?
+    for(ip = b->head; ip; ip = ip->next){
+      if(ip->dev == dev && ip->inum == inum){
+        if(ip->ref++ == 0){
+          acquire(&itable.lock);
+          lruremove(ip);
+          release(&itable.lock);
+        }
+        release(&b->lock);
+        if(empty)
+          iunnew(empty);
+        return ip;
+      }
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
-  }
+    if(empty)
+      break;
 
-  // Recycle an inode entry.
-  if(empty == 0)
-    panic("iget: no inodes");
+    // Get an entry without holding b->lock, then look
+    // again in case another process added the inode.
+    release(&b->lock);
+    if((empty = inew()) == 0)
+      panic("iget: no inodes");
+    acquire(&b->lock);
+  }
 
   ip = empty;
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
-  release(&itable.lock);
+  ip->pages = 0;
+  ip->pinned = 0;
+  ip->next = b->head;
+  b->head = ip;
+  release(&b->lock);
 
   return ip;
 }
@@ -277,9 +464,11 @@ iget(uint dev, uint inum)
 struct inode*
 idup(struct inode *ip)
 {
-  acquire(&itable.lock);
+  struct ibucket *b = ibucket(ip->dev, ip->inum);
+
+  acquire(&b->lock);
   ip->ref++;
-  release(&itable.lock);
+  release(&b->lock);
   return ip;
 }
 
@@ -297,6 +486,8 @@ ilock(struct inode *ip)
   acquiresleep(&ip->lock);
 
   if(ip->valid == 0){
+    if(istmp(ip->dev))
+      panic("ilock: tmpfs");
     bp = bread(ip->dev, IBLOCK(ip->inum, sb));
     dip = (struct dinode*)bp->data + ip->inum%IPB;
     ip->type = dip->type;
@@ -322,6 +513,36 @@ iunlock(struct inode *ip)
   releasesleep(&ip->lock);
 }
 
+// Lock the given inode shared with other readers,
+// who may look at it and read its content but not
+// change either. Reads the inode from disk if necessary.
+void
+ilockshared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilockshared");
+
+  acquiresleepshared(&ip->lock);
+
+  if(ip->valid == 0){
+    // let ilock() read it in, exclusively.
+    releasesleepshared(&ip->lock);
+    ilock(ip);
+    iunlock(ip);
+    acquiresleepshared(&ip->lock);
+  }
+}
+
+// Unlock an inode locked with ilockshared().
+void
+iunlockshared(struct inode *ip)
+{
+  if(ip == 0 || !holdingsleepshared(&ip->lock) || ip->ref < 1)
+    panic("iunlockshared");
+
+  releasesleepshared(&ip->lock);
+}
+
 // Drop a reference to an in-memory inode.
 // If that was the last reference, the inode table entry can
 // be recycled.
@@ -332,7 +553,9 @@ iunlock(struct inode *ip)
 void
 iput(struct inode *ip)
 {
-  acquire(&itable.lock);
+  struct ibucket *b = ibucket(ip->dev, ip->inum);
+
+  acquire(&b->lock);
 
   if(ip->ref == 1 && ip->valid && ip->nlink == 0){
     // inode has no links and no other references: truncate and free.
@@ -341,20 +564,32 @@ iput(struct inode *ip)
     // so this acquiresleep() won't block (or deadlock).
     acquiresleep(&ip->lock);
 
-    release(&itable.lock);
+    release(&b->lock);
 
+    if(ip->type == T_DIR)
+      dcachepurge(ip->dev, ip->inum);
     itrunc(ip);
     ip->type = 0;
     iupdate(ip);
     ip->valid = 0;
+    if(istmp(ip->dev))
+      tmpifree(ip->dev, ip->inum);
 
     releasesleep(&ip->lock);
 
-    acquire(&itable.lock);
+    acquire(&b->lock);
   }
 
-  ip->ref--;
-  release(&itable.lock);
+  if(--ip->ref == 0){
+    // keep it cached, most recently used first.
+    acquire(&itable.lock);
+    ip->lrunext = itable.lru.lrunext;
+    ip->prev = &itable.lru;
+    itable.lru.lrunext->prev = ip;
+    itable.lru.lrunext = ip;
+    release(&itable.lock);
+  }
+  release(&b->lock);
 }
 
 // Common idiom: unlock, then put.
@@ -413,6 +648,11 @@ itrunc(struct inode *ip)
   struct buf *bp;
   uint *a;
 
+  if(istmp(ip->dev)){
+    tmptrunc(ip);
+    return;
+  }
+
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
       bfree(ip->dev, ip->addrs[i]);
@@ -449,7 +689,7 @@ stati(struct inode *ip, struct stat *st)
 }
 
 // Read data from inode.
-// Caller must hold ip->lock.
+// Caller must hold ip->lock, exclusive or shared.
 // If user_dst==1, then dst is a user virtual address;
 // otherwise, dst is a kernel address.
 int
@@ -458,20 +698,23 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   uint tot, m;
   struct buf *bp;
 
+  if(istmp(ip->dev))
+    return tmpread(ip, user_dst, dst, off, n);
+
   if(off > ip->size || off + n < off)
     return 0;
   if(off + n > ip->size)
     n = ip->size - off;
 
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
+    bp = breadshared(ip->dev, bmap(ip, off/BSIZE));
     m = min(n - tot, BSIZE - off%BSIZE);
     if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
-      brelse(bp);
+      brelseshared(bp);
       tot = -1;
       break;
     }
-    brelse(bp);
+    brelseshared(bp);
   }
   return tot;
 }
@@ -489,6 +732,9 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
   uint tot, m;
   struct buf *bp;
 
+  if(istmp(ip->dev))
+    return tmpwrite(ip, user_src, src, off, n);
+
   if(off > ip->size || off + n < off)
     return -1;
   if(off + n > MAXFILE*BSIZE)
@@ -524,16 +770,198 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
-// Look for a directory entry in a directory.
-// If found, set *poff to byte offset of entry.
-struct inode*
-dirlookup(struct inode *dp, char *name, uint *poff)
+// Directory name lookup cache.
+//
+// dirlookup() otherwise has to read every entry of a directory
+// through the buffer cache, and namex() calls it for each path
+// element. The dcache remembers recent answers, hashed on
+// (dev, directory inum, name): an entry holds the inum and the
+// byte offset of the matching dirent, or inum 0 to record that
+// the name is not present (a negative entry).
+//
+// dirlink() and dirunlink() update the cache along with the
+// directory, and freeing a directory inode drops all of its
+// entries, so cached answers never go stale. Callers of all of
+// these hold the directory's lock; dcache.lock protects the
+// cache itself.
+
+#define NDENTRY 128  // cached names
+#define NDHASH  61   // hash buckets
+
+struct dentry {
+  uint dev;
+  uint dir;              // directory inum; 0 if the entry is free
+  uint inum;             // what name maps to; 0 if absent
+  uint off;              // offset of name's dirent in dir
+  char name[DIRSIZ];
+  int used;              // recently used? (for replacement)
+  struct dentry *next;   // hash chain
+};
+
+struct {
+  struct spinlock lock;
+  struct dentry dentry[NDENTRY];
+  struct dentry *hash[NDHASH];
+  int hand;              // clock hand for replacement
+  struct dcachestat stat;
+} dcache;
+
+static void
+dcacheinit(void)
 {
-  uint off, inum;
-  struct dirent de;
+  initlock(&dcache.lock, "dcache");
+}
 
-  if(dp->type != T_DIR)
-    panic("dirlookup not DIR");
+static uint
+dhash(uint dev, uint dir, char *name)
+{
+  uint h = dev * 31 + dir;
+  int i;
+
+  for(i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + (uchar)name[i];
+  return h % NDHASH;
+}
+
+// Find the entry for name in directory (dev, dir).
+// Caller must hold dcache.lock.
+static struct dentry*
+dfind(uint dev, uint dir, char *name)
+{
+  struct dentry *d;
+
+  for(d = dcache.hash[dhash(dev, dir, name)]; d; d = d->next){
+    if(d->dev == dev && d->dir == dir && namecmp(d->name, name) == 0)
+      return d;
+  }
+  return 0;
+}
+
+// Remove d from its hash chain and mark it free.
+// Caller must hold dcache.lock.
+static void
+dunhash(struct dentry *d)
+{
+  struct dentry **pp;
+
+  for(pp = &dcache.hash[dhash(d->dev, d->dir, d->name)]; *pp; pp = &(*pp)->next){
+    if(*pp == d){
+      *pp = d->next;
+      break;
+    }
+  }
+  d->dir = 0;
+}
+
+// Look up name in directory dp.
+// Returns 1 and sets *inum (0 if the name is known to be
+// absent) and *off on a hit, 0 on a miss.
+static int
+dcachelookup(struct inode *dp, char *name, uint *inum, uint *off)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  if((d = dfind(dp->dev, dp->inum, name)) == 0){
+    dcache.stat.misses++;
+    release(&dcache.lock);
+    return 0;
+  }
+  d->used = 1;
+  *inum = d->inum;
+  *off = d->off;
+  if(d->inum)
+    dcache.stat.hits++;
+  else
+    dcache.stat.neghits++;
+  release(&dcache.lock);
+  return 1;
+}
+
+// Record that name in directory dp maps to inum (0 for absent),
+// with its dirent at off.
+static void
+dcacheenter(struct inode *dp, char *name, uint inum, uint off)
+{
+  struct dentry *d;
+  uint h;
+
+  acquire(&dcache.lock);
+  if((d = dfind(dp->dev, dp->inum, name)) == 0){
+    // recycle an entry that hasn't been used since
+    // the hand last passed it.
+    for(;;){
+      d = &dcache.dentry[dcache.hand];
+      dcache.hand = (dcache.hand + 1) % NDENTRY;
+      if(d->dir == 0 || d->used == 0)
+        break;
+      d->used = 0;
+    }
+    if(d->dir)
+      dunhash(d);
+    d->dev = dp->dev;
+    d->dir = dp->inum;
+    strncpy(d->name, name, DIRSIZ);
+    h = dhash(d->dev, d->dir, d->name);
+    d->next = dcache.hash[h];
+    dcache.hash[h] = d;
+  }
+  d->inum = inum;
+  d->off = off;
+  d->used = 1;
+  release(&dcache.lock);
+}
+
+// Drop every cached name in directory (dev, dir),
+// which is being freed.
+static void
+dcachepurge(uint dev, uint dir)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  for(d = dcache.dentry; d < &dcache.dentry[NDENTRY]; d++){
+    if(d->dir == dir && d->dev == dev)
+      dunhash(d);
+  }
+  release(&dcache.lock);
+}
+
+// Copy out the cache's hit and miss counters.
+void
+dcachestat(struct dcachestat *st)
+{
+  acquire(&dcache.lock);
+  *st = dcache.stat;
+  release(&dcache.lock);
+}
+
+// Directories come in two formats (see fs.h). A linear
+// directory is searched from the start; a hashed directory
+// looks the name's hash up in its index block to find the one
+// block that can hold it, so lookups and creates cost the same
+// in a directory of ten names or thousands.
+
+static uint
+dirhash(char *name)
+{
+  uint h = 2166136261;  // FNV-1a; mkfs has a copy
+  int i;
+
+  for(i = 0; i < DIRSIZ && name[i]; i++){
+    h ^= (uchar)name[i];
+    h *= 16777619;
+  }
+  return h;
+}
+
+// Search a linear directory for name.
+// Returns its inum and sets *poff, or returns 0.
+static uint
+dirscan(struct inode *dp, char *name, uint *poff)
+{
+  uint off;
+  struct dirent de;
 
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
@@ -542,17 +970,198 @@ dirlookup(struct inode *dp, char *name, uint *poff)
       continue;
     if(namecmp(name, de.name) == 0){
       // entry matches path element
-      if(poff)
-        *poff = off;
-      inum = de.inum;
-      return iget(dp->dev, inum);
+      *poff = off;
+      return de.inum;
+    }
+  }
+  return 0;
+}
+
+// Find the index entry covering hash h.
+static struct dxentry*
+dxfind(struct dxentry *dx, uint h)
+{
+  int lo, hi, mid;
+
+  // the last entry i with dx[i].hash <= h.
+  lo = 1;
+  hi = dx[0].blk;
+  while(lo < hi){
+    mid = (lo + hi + 1) / 2;
+    if(dx[mid].hash <= h)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return &dx[lo];
+}
+
+// Return the directory block that holds name, if it is present.
+static uint
+dxblock(struct inode *dp, char *name)
+{
+  struct buf *bp;
+  uint blk;
+
+  bp = breadshared(dp->dev, bmap(dp, 0));
+  blk = dxfind((struct dxentry*)bp->data, dirhash(name))->blk;
+  brelseshared(bp);
+  return blk;
+}
+
+// Search a hashed directory for name.
+// Returns its inum and sets *poff, or returns 0.
+static uint
+dxscan(struct inode *dp, char *name, uint *poff)
+{
+  struct buf *bp;
+  struct dirent *de;
+  uint blk, inum;
+
+  blk = dxblock(dp, name);
+  bp = breadshared(dp->dev, bmap(dp, blk));
+  for(de = (struct dirent*)bp->data; de < (struct dirent*)bp->data + DPB; de++){
+    if(de->inum != 0 && namecmp(name, de->name) == 0){
+      *poff = blk*BSIZE + (de - (struct dirent*)bp->data) * sizeof(*de);
+      inum = de->inum;
+      brelseshared(bp);
+      return inum;
     }
   }
+  brelseshared(bp);
+  return 0;
+}
+
+// Look for a directory entry in a directory.
+// If found, set *poff to byte offset of entry.
+// Caller must hold dp->lock, exclusive or shared.
+struct inode*
+dirlookup(struct inode *dp, char *name, uint *poff)
+{
+  uint off, inum;
+
+  if(dp->type != T_DIR)
+    panic("dirlookup not DIR");
+
+  if(!dcachelookup(dp, name, &inum, &off)){
+    off = 0;
+    if(dp->major == DIR_HASHED)
+      inum = dxscan(dp, name, &off);
+    else
+      inum = dirscan(dp, name, &off);
+    dcacheenter(dp, name, inum, off);
+  }
+  if(inum == 0)
+    return 0;
+  if(poff)
+    *poff = off;
+  return iget(dp->dev, inum);
+}
+
+// Split the full block bp of hashed directory dp, found
+// through index entry e of index block ibp: names hashing
+// to the upper half move to a new block. Returns -1 if the
+// index or the directory is full, or if every name in bp
+// has the same hash.
+static int
+dxsplit(struct inode *dp, struct buf *ibp, struct dxentry *e, struct buf *bp)
+{
+  struct dxentry *dx = (struct dxentry*)ibp->data;
+  struct dirent *de, *nde;
+  struct buf *nbp;
+  uint h[DPB], mid, t, nblk;
+  int i, j;
+
+  nblk = dp->size / BSIZE;
+  if(dx[0].blk >= NDXENTRY || nblk >= MAXFILE)
+    return -1;
+
+  // split at the median hash, moving it up past any
+  // duplicates of the lowest so that something stays.
+  de = (struct dirent*)bp->data;
+  for(i = 0; i < DPB; i++){
+    t = dirhash(de[i].name);
+    for(j = i; j > 0 && h[j-1] > t; j--)
+      h[j] = h[j-1];
+    h[j] = t;
+  }
+  for(i = DPB/2; i < DPB && h[i] == h[0]; i++)
+    ;
+  if(i == DPB)
+    return -1;
+  mid = h[i];
+
+  nbp = bread(dp->dev, bmap(dp, nblk));
+  nde = (struct dirent*)nbp->data;
+  for(i = 0; i < DPB; i++){
+    if(dirhash(de[i].name) < mid)
+      continue;
+    *nde = de[i];
+    dcacheenter(dp, nde->name, nde->inum, nblk*BSIZE + (nde - (struct dirent*)nbp->data) * sizeof(*nde));
+    nde++;
+    memset(&de[i], 0, sizeof(de[i]));
+  }
+  log_write(nbp);
+  brelse(nbp);
+  log_write(bp);
+
+  memmove(e+2, e+1, (char*)&dx[dx[0].blk+1] - (char*)(e+1));
+  e[1].zero = 0;
+  e[1].blk = nblk;
+  e[1].hash = mid;
+  dx[0].blk++;
+  log_write(ibp);
 
+  dp->size = (nblk+1) * BSIZE;
+  iupdate(dp);
   return 0;
 }
 
+// Add (name, inum) to hashed directory dp, splitting
+// the block it belongs in if that is full. Splits at most
+// once, and fails if the block is still full, so that one
+// file system operation writes a bounded number of blocks:
+// a split logs the new block, a bitmap block, an indirect
+// block, the old block, the index, and dp's inode. With
+// the new inode and, for mkdir, its two blocks and their
+// bitmap block, that is at most MAXOPBLOCKS.
+static int
+dxlink(struct inode *dp, char *name, uint inum)
+{
+  struct buf *ibp, *bp;
+  struct dxentry *e;
+  struct dirent *de;
+  uint off;
+  int split;
+
+  for(split = 0; ; split++){
+    ibp = bread(dp->dev, bmap(dp, 0));
+    e = dxfind((struct dxentry*)ibp->data, dirhash(name));
+    bp = bread(dp->dev, bmap(dp, e->blk));
+    for(de = (struct dirent*)bp->data; de < (struct dirent*)bp->data + DPB; de++){
+      if(de->inum == 0){
+        strncpy(de->name, name, DIRSIZ);
+        de->inum = inum;
+        log_write(bp);
+        off = e->blk*BSIZE + (de - (struct dirent*)bp->data) * sizeof(*de);
+        brelse(bp);
+        brelse(ibp);
+        dcacheenter(dp, name, inum, off);
+        return 0;
+      }
+    }
+    if(split || dxsplit(dp, ibp, e, bp) < 0){
+      brelse(bp);
+      brelse(ibp);
+      return -1;
+    }
+    brelse(bp);
+    brelse(ibp);
+  }
+}
+
 // Write a new directory entry (name, inum) into the directory dp.
+// Returns -1 if name is present or the directory is full.
 int
 dirlink(struct inode *dp, char *name, uint inum)
 {
@@ -566,6 +1175,9 @@ dirlink(struct inode *dp, char *name, uint inum)
     return -1;
   }
 
+  if(dp->major == DIR_HASHED)
+    return dxlink(dp, name, inum);
+
   // Look for an empty dirent.
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
@@ -577,11 +1189,68 @@ dirlink(struct inode *dp, char *name, uint inum)
   strncpy(de.name, name, DIRSIZ);
   de.inum = inum;
   if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-    panic("dirlink");
+    return -1;
+  dcacheenter(dp, name, inum, off);
 
   return 0;
 }
 
+// Fill in the new directory dp with "." and "..",
+// which refers to parent. The directory is hashed if
+// the file system asks for that.
+// Returns -1 if dp's blocks can't be allocated.
+int
+dirinit(struct inode *dp, uint parent)
+{
+  static char zeros[2*BSIZE];
+  struct dxentry dx[2];
+
+  if((sb.flags & FS_HASHDIR) && !istmp(dp->dev)){
+    dp->major = DIR_HASHED;
+    // an index with one entry, for all hashes, pointing at
+    // an empty block 1. writei() won't leave a hole, so
+    // write both blocks from the start.
+    memset(dx, 0, sizeof(dx));
+    dx[0].blk = 1;
+    dx[1].blk = 1;
+    if(writei(dp, 0, (uint64)dx, 0, sizeof(dx)) != sizeof(dx) ||
+       writei(dp, 0, (uint64)zeros, sizeof(dx), 2*BSIZE - sizeof(dx)) != 2*BSIZE - sizeof(dx))
+      return -1;
+  }
+  if(dirlink(dp, ".", dp->inum) < 0 || dirlink(dp, "..", parent) < 0)
+    return -1;
+  return 0;
+}
+
+// Is the directory dp empty except for "." and ".." ?
+int
+dirempty(struct inode *dp)
+{
+  uint off;
+  struct dirent de;
+
+  for(off = 0; off < dp->size; off += sizeof(de)){
+    if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+      panic("dirempty: readi");
+    if(de.inum != 0 && namecmp(de.name, ".") != 0 && namecmp(de.name, "..") != 0)
+      return 0;
+  }
+  return 1;
+}
+
+// Remove the entry for name, found by dirlookup() at off,
+// from the directory dp.
+void
+dirunlink(struct inode *dp, char *name, uint off)
+{
+  struct dirent de;
+
+  memset(&de, 0, sizeof(de));
+  if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+    panic("dirunlink");
+  dcacheenter(dp, name, 0, 0);
+}
+
 // Paths
 
 // Copy the next path element from path into name.
@@ -621,6 +1290,119 @@ skipelem(char *path, char *name)
   return path;
 }
 
+// Mount a new, empty tmpfs on directory ip, which the
+// caller has referenced but not locked. On success the
+// mount keeps the reference. Returns 0, or -1 if ip is
+// already a mount point, there are too many mounts, or
+// memory is short.
+// Must be called inside a transaction.
+int
+mount(struct inode *ip)
+{
+  struct inode *root;
+  int dev;
+
+  if((dev = tmpfsalloc()) < 0)
+    return -1;
+
+  // claim ip before making the root, so that two
+  // processes can't both mount on it. mountdown()
+  // ignores the mount until it has a root.
+  acquire(&mtable.lock);
+  if(ismount(ip)){
+    release(&mtable.lock);
+    tmpfsfree(dev);
+    return -1;
+  }
+  mtable.mount[dev - TMPDEV].on = ip;
+  mtable.mount[dev - TMPDEV].root = 0;
+  release(&mtable.lock);
+
+  if((root = ialloc(dev, T_DIR)) == 0)
+    goto bad;
+  ilock(root);
+  root->nlink = 1;
+  iupdate(root);
+  if(dirinit(root, root->inum) < 0){
+    // unlinked, iput() frees it and its pages.
+    root->nlink = 0;
+    iupdate(root);
+    iunlockput(root);
+    goto bad;
+  }
+  iunlock(root);
+
+  acquire(&mtable.lock);
+  mtable.mount[dev - TMPDEV].root = root;
+  release(&mtable.lock);
+  return 0;
+
+ bad:
+  acquire(&mtable.lock);
+  mtable.mount[dev - TMPDEV].on = 0;
+  release(&mtable.lock);
+  tmpfsfree(dev);
+  return -1;
+}
+
+// Is something mounted on ip?
+// Caller must hold mtable.lock.
+static int
+ismount(struct inode *ip)
+{
+  int i;
+
+  for(i = 0; i < NMOUNT; i++)
+    if(mtable.mount[i].on == ip)
+      return 1;
+  return 0;
+}
+
+// Is something mounted on ip?
+int
+mounted(struct inode *ip)
+{
+  int r;
+
+  acquire(&mtable.lock);
+  r = ismount(ip);
+  release(&mtable.lock);
+  return r;
+}
+
+// If something is mounted on directory ip, return
+// its root instead. Consumes the reference to ip.
+static struct inode*
+mountdown(struct inode *ip)
+{
+  struct inode *root = 0;
+  int i;
+
+  acquire(&mtable.lock);
+  for(i = 0; i < NMOUNT; i++)
+    if(mtable.mount[i].on == ip)
+      root = mtable.mount[i].root;
+  release(&mtable.lock);
+  if(root == 0)
+    return ip;
+  iput(ip);
+  return idup(root);
+}
+
+// If ip is the root of a tmpfs, return the directory
+// it's mounted on instead. Consumes the reference to ip.
+static struct inode*
+mountup(struct inode *ip)
+{
+  struct inode *on;
+
+  if(!istmp(ip->dev) || ip->inum != ROOTINO)
+    return ip;
+  on = mtable.mount[ip->dev - TMPDEV].on;
+  iput(ip);
+  return idup(on);
+}
+
 // Look up and return the inode for a path name.
 // If parent != 0, return the inode for the parent and copy the final
 // path element into name, which must have room for DIRSIZ bytes.
@@ -636,22 +1418,29 @@ namex(char *path, int nameiparent, char *name)
     ip = idup(myproc()->cwd);
 
   while((path = skipelem(path, name)) != 0){
-    ilock(ip);
+    // ".." from the root of a tmpfs leads out of it.
+    if(namecmp(name, "..") == 0 && !(nameiparent && *path == '\0'))
+      ip = mountup(ip);
+
+    // lookups only read the directory, so processes
+    // walking the same directories needn't take turns.
+    ilockshared(ip);
     if(ip->type != T_DIR){
-      iunlockput(ip);
+      iunlockshared(ip);
+      iput(ip);
       return 0;
     }
     if(nameiparent && *path == '\0'){
       // Stop one level early.
-      iunlock(ip);
+      iunlockshared(ip);
       return ip;
     }
-    if((next = dirlookup(ip, name, 0)) == 0){
-      iunlockput(ip);
+    next = dirlookup(ip, name, 0);
+    iunlockshared(ip);
+    iput(ip);
+    if(next == 0)
       return 0;
-    }
-    iunlockput(ip);
-    ip = next;
+    ip = mountdown(next);
   }
   if(nameiparent){
     iput(ip);
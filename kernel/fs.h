@@ -7,7 +7,7 @@
 
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
-//                                          free bit map | data blocks]
+//                            free bit map | data blocks | swap area ]
 //
 // mkfs computes the super block and builds an initial file system. The
 // super block describes the disk layout:
@@ -20,10 +20,15 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint flags;        // FS_* feature flags
+  uint swapstart;    // Block number of first swap block
+  uint nswap;        // Number of swap blocks
 };
 
 #define FSMAGIC 0x10203040
 
+#define FS_HASHDIR 0x1   // create new directories hashed
+
 #define NDIRECT 12
 #define NINDIRECT (BSIZE / sizeof(uint))
 #define MAXFILE (NDIRECT + NINDIRECT)
@@ -31,7 +36,8 @@ struct superblock {
 // On-disk inode structure
 struct dinode {
   short type;           // File type
-  short major;          // Major device number (T_DEVICE only)
+  short major;          // Major device number (T_DEVICE only),
+                        // or DIR_* format (T_DIR only)
   short minor;          // Minor device number (T_DEVICE only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
@@ -51,10 +57,32 @@ struct dinode {
 #define BBLOCK(b, sb) ((b)/BPB + sb.bmapstart)
 
 // Directory is a file containing a sequence of dirent structures.
-#define DIRSIZ 14
+#define DIRSIZ 30
 
 struct dirent {
   ushort inum;
   char name[DIRSIZ];
 };
 
+// Dirents per block.
+#define DPB           (BSIZE / sizeof(struct dirent))
+
+// Directory formats.
+#define DIR_LINEAR 0  // dirents in no particular order
+#define DIR_HASHED 1  // index block, then blocks of dirents by name hash
+
+// Block 0 of a hashed directory is an index: dx[0].blk is the
+// number of entries that follow, and entry i says that names
+// hashing to at least dx[i].hash, and less than dx[i+1].hash,
+// live in directory block dx[i].blk. dx[1].hash is always 0.
+// Every entry starts with a zero, so a program that reads the
+// index block as dirents sees only empty slots.
+struct dxentry {
+  ushort zero;   // overlays dirent.inum
+  ushort blk;    // directory block number (count, in dx[0])
+  uint hash;     // lowest name hash in blk
+};
+
+// Entries in an index block, not counting dx[0].
+#define NDXENTRY      (BSIZE / sizeof(struct dxentry) - 1)
+
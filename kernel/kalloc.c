@@ -1,6 +1,13 @@
 // Physical memory allocator, for user processes,
-// kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// kernel stacks, page-table pages, and slabs.
+//
+// A buddy allocator: free memory is kept as blocks of
+// 2^order pages, aligned to their size, on one list per
+// order. An allocation splits a larger block when no block
+// of the right order is free, and a free merges a block
+// with its buddy (the other half of the block of the next
+// order up) for as long as the buddy is free too.
+// kalloc() and kfree() deal in single pages (order 0).
 
 #include "types.h"
 #include "param.h"
@@ -8,6 +15,7 @@
 #include "spinlock.h"
 #include "riscv.h"
 #include "defs.h"
+#include "stat.h"
 
 void freerange(void *pa_start, void *pa_end);
 
@@ -16,18 +24,43 @@ extern char end[]; // first address after kernel.
 
 struct run {
   struct run *next;
+  struct run *prev;
 };
 
 struct {
   struct spinlock lock;
-  struct run *freelist;
+  struct run free[MAXORDER+1];   // circular list heads
+  uint nblock[MAXORDER+1];       // blocks on each list
+  uint64 npage;                  // pages handed to the allocator
+  // for each page of RAM that starts a free block, the
+  // block's order plus one; zero for all other pages.
+  // kinit() puts it just after the kernel.
+  uchar *order;
+  char *base;                    // first page after order[]
 } kmem;
 
 void
 kinit()
 {
-  initlock(&kmem.lock, "kmem");
-  freerange(end, (void*)PHYSTOP);
+  uint64 rdstart, rdend, n;
+  int i;
+
+  initticketlock(&kmem.lock, "kmem");
+  for(i = 0; i <= MAXORDER; i++)
+    kmem.free[i].next = kmem.free[i].prev = &kmem.free[i];
+  n = (physend - KERNBASE) / PGSIZE;
+  kmem.order = (uchar*)end;
+  memset(kmem.order, 0, n);
+  kmem.base = (char*)PGROUNDUP((uint64)end + n);
+  if(fdtinitrd(&rdstart, &rdend)){
+    // leave the image from qemu -initrd alone; see ramdisk.c.
+    if(rdstart < (uint64)kmem.base)
+      panic("kinit: initrd");
+    freerange(kmem.base, (void*)rdstart);
+    freerange((void*)rdend, (void*)physend);
+  } else {
+    freerange(kmem.base, (void*)physend);
+  }
 }
 
 void
@@ -35,31 +68,115 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    kmem.npage++;
     kfree(p);
+  }
 }
 
-// Free the page of physical memory pointed at by v,
-// which normally should have been returned by a
-// call to kalloc().  (The exception is when
-// initializing the allocator; see kinit above.)
+static int
+pageindex(uint64 pa)
+{
+  return (pa - KERNBASE) / PGSIZE;
+}
+
+// Put block b of order k on its free list.
+// Caller must hold kmem.lock.
+static void
+blockpush(struct run *b, int k)
+{
+  struct run *h = &kmem.free[k];
+
+  b->next = h->next;
+  b->prev = h;
+  h->next->prev = b;
+  h->next = b;
+  kmem.order[pageindex((uint64)b)] = k + 1;
+  kmem.nblock[k]++;
+}
+
+// Take block b of order k off its free list.
+// Caller must hold kmem.lock.
+static void
+blockremove(struct run *b, int k)
+{
+  b->prev->next = b->next;
+  b->next->prev = b->prev;
+  kmem.order[pageindex((uint64)b)] = 0;
+  kmem.nblock[k]--;
+}
+
+// Free the 2^order pages at pa, which normally should
+// have been returned by kallocorder(order). (The
+// exception is when initializing the allocator; see
+// kinit above.)
 void
-kfree(void *pa)
+kfreeorder(void *pa, int order)
 {
-  struct run *r;
+  uint64 b, buddy;
 
-  if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+  if(order < 0 || order > MAXORDER || ((uint64)pa % (PGSIZE << order)) != 0 ||
+     (char*)pa < kmem.base || (uint64)pa + (PGSIZE << order) > physend)
     panic("kfree");
 
   // Fill with junk to catch dangling refs.
-  memset(pa, 1, PGSIZE);
+  memset(pa, 1, PGSIZE << order);
 
-  r = (struct run*)pa;
+  b = (uint64)pa;
+  acquire(&kmem.lock);
+  for(; order < MAXORDER; order++){
+    buddy = b ^ (PGSIZE << order);
+    if(buddy < (uint64)kmem.base || buddy >= physend ||
+       kmem.order[pageindex(buddy)] != order + 1)
+      break;
+    blockremove((struct run*)buddy, order);
+    if(buddy < b)
+      b = buddy;
+  }
+  blockpush((struct run*)b, order);
+  release(&kmem.lock);
+}
+
+// Allocate 2^order physically contiguous pages,
+// aligned to their size. Returns a pointer that the
+// kernel can use, or 0 if the memory cannot be allocated.
+void *
+kallocorder(int order)
+{
+  struct run *r;
+  int k;
+
+  if(order < 0 || order > MAXORDER)
+    return 0;
 
   acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
+  for(k = order; k <= MAXORDER; k++)
+    if(kmem.nblock[k] > 0)
+      break;
+  if(k > MAXORDER){
+    release(&kmem.lock);
+    return 0;
+  }
+  r = kmem.free[k].next;
+  blockremove(r, k);
+  // give back the upper half until the block is small enough.
+  while(k > order){
+    k--;
+    blockpush((struct run*)((char*)r + (PGSIZE << k)), k);
+  }
   release(&kmem.lock);
+
+  memset((char*)r, 5, PGSIZE << order); // fill with junk
+  return (void*)r;
+}
+
+// Free the page of physical memory pointed at by pa,
+// which normally should have been returned by a
+// call to kalloc().
+void
+kfree(void *pa)
+{
+  kfreeorder(pa, 0);
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -70,13 +187,31 @@ kalloc(void)
 {
   struct run *r;
 
+  // fast path: take a free page without looking for a split.
   acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r)
-    kmem.freelist = r->next;
+  if(kmem.nblock[0] > 0){
+    r = kmem.free[0].next;
+    blockremove(r, 0);
+    release(&kmem.lock);
+    memset((char*)r, 5, PGSIZE); // fill with junk
+    return (void*)r;
+  }
   release(&kmem.lock);
+  return kallocorder(0);
+}
 
-  if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
-  return (void*)r;
+// Fill in st with the number of free blocks of each order.
+void
+kmemstat(struct memstat *st)
+{
+  int k;
+
+  acquire(&kmem.lock);
+  st->npage = kmem.npage;
+  st->nfree = 0;
+  for(k = 0; k <= MAXORDER; k++){
+    st->nblock[k] = kmem.nblock[k];
+    st->nfree += (uint64)kmem.nblock[k] << k;
+  }
+  release(&kmem.lock);
 }
@@ -16,19 +16,27 @@ main()
     printf("\n");
     printf("xv6 kernel is booting\n");
     printf("\n");
+    fdtinit();       // boot information from qemu
     kinit();         // physical page allocator
+    slabinit();      // small object allocator
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
     trapinit();      // trap vectors
+    profinit();      // sampling profiler
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
+    swapinit();      // swap space
     iinit();         // inode table
+    tmpfsinit();     // in-memory file systems
     fileinit();      // file table
-    virtio_disk_init(); // emulated hard disk
+    pipeinit();      // pipe cache
+    if(!ramdiskinit()) // disk image from qemu -initrd
+      virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
+    kthread("swapd", swapd); // page-out daemon
     __sync_synchronize();
     started = 1;
   } else {
@@ -15,7 +15,7 @@
 // the kernel uses physical memory thus:
 // 80000000 -- entry.S, then kernel text and data
 // end -- start of kernel page allocation area
-// PHYSTOP -- end RAM used by the kernel
+// physend -- end RAM used by the kernel
 
 // qemu puts UART registers here in physical memory.
 #define UART0 0x10000000L
@@ -41,11 +41,22 @@
 #define PLIC_MCLAIM(hart) (PLIC + 0x200004 + (hart)*0x2000)
 #define PLIC_SCLAIM(hart) (PLIC + 0x201004 + (hart)*0x2000)
 
+// user memory runs from 0 up to at most MAXUSER, 192MB. a
+// process's kernel page table maps it with first-level entries
+// copied from the user page table (see kvmsync() in vm.c), and
+// the entries from PLIC up belong to the kernel's device
+// mappings, so a process can't have more.
+#define MAXUSER PLIC
+
 // the kernel expects there to be RAM
 // for use by the kernel and user pages
-// from physical address 0x80000000 to PHYSTOP.
+// from physical address 0x80000000 to physend,
+// which fdtinit() reads from the device tree. it
+// is PHYSTOP if the device tree doesn't say, and
+// at most PHYSMAX.
 #define KERNBASE 0x80000000L
 #define PHYSTOP (KERNBASE + 128*1024*1024)
+#define PHYSMAX (KERNBASE + 64L*1024*1024*1024)
 
 // map the trampoline page to the highest address,
 // in both user and kernel space.
@@ -62,6 +73,8 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   RING (p->ring, system call ring, only if ringsetup() was called)
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define RING (TRAPFRAME - PGSIZE)
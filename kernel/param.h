@@ -1,13 +1,16 @@
-#define NPROC        64  // maximum number of processes
+#define NPROC      1024  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
+#define NMOUNT        4  // maximum number of mounted tmpfs
+#define TMPDEV      100  // device number of the first tmpfs
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       1000  // size of file system in blocks
+#define NBUF         (MAXOPBLOCKS*3)  // minimum size of disk block cache
+#define FSSIZE       4000  // size of file system in blocks
+#define SWAPSIZE     32768 // size of swap area after it, in blocks
 #define MAXPATH      128   // maximum file path name
+#define NSYSCALL     64    // system call numbers are below this
@@ -5,20 +5,55 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "wait.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// Every struct proc ever made, up to NPROC of them. They are
+// made when no UNUSED one is left, each with a kernel stack
+// at KSTACK(its index), and never freed. procs[] only grows,
+// so procs[0..nproc-1] may be read without a lock.
+struct proc *procs[NPROC];
+int nproc;
+
+static struct {
+  struct spinlock lock;   // guards nproc, free, and making procs
+  struct proc *free;      // UNUSED procs
+} ptable;
+
+static struct kmem_cache *proccache;
+
+// RUNNABLE processes, in the order they became runnable,
+// for scheduler().
+static struct {
+  struct spinlock lock;
+  struct proc *head, *tail;
+} runq;
+
+// SLEEPING processes, hashed by p->chan, so that wakeup()
+// looks only at those that might be sleeping on its chan.
+#define NSLEEPQ 64
+static struct sleepq {
+  struct spinlock lock;
+  struct proc *head;
+} sleepq[NSLEEPQ];
 
 struct proc *initproc;
 
 int nextpid = 1;
-struct spinlock pid_lock;
+struct spinlock pid_lock;   // guards nextpid and pidhash[]
+
+// processes by pid, for kill() and friends.
+#define NPIDHASH 1024
+static struct proc *pidhash[NPIDHASH];
 
 extern void forkret(void);
+static void kthreadstart(void);
 static void freeproc(struct proc *p);
+static void adopt(struct proc *parent, struct proc *child);
 
 extern char trampoline[]; // trampoline.S
+extern pagetable_t kernel_pagetable; // vm.c
 
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
@@ -26,33 +61,134 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
-// Allocate a page for each process's kernel stack.
-// Map it high in memory, followed by an invalid
-// guard page.
+// initialize the proc table at boot time.
 void
-proc_mapstacks(pagetable_t kpgtbl) {
+procinit(void)
+{
+  int i;
+
+  initlock(&pid_lock, "nextpid");
+  initlock(&wait_lock, "wait_lock");
+  initlock(&ptable.lock, "ptable");
+  initticketlock(&runq.lock, "runq");
+  for(i = 0; i < NSLEEPQ; i++)
+    initlock(&sleepq[i].lock, "sleepq");
+  proccache = kmem_cache_create("proc", sizeof(struct proc));
+}
+
+// Make a new struct proc, procs[nproc], with a kernel stack.
+// Returns 0 if there are NPROC already or memory is short.
+// Caller must hold ptable.lock.
+static struct proc*
+newproc(void)
+{
   struct proc *p;
-  
-  for(p = proc; p < &proc[NPROC]; p++) {
-    char *pa = kalloc();
-    if(pa == 0)
-      panic("kalloc");
-    uint64 va = KSTACK((int) (p - proc));
-    kvmmap(kpgtbl, va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
+  char *stack;
+  int i = nproc;
+
+  if(i >= NPROC || (p = kmem_cache_alloc(proccache)) == 0)
+    return 0;
+  memset(p, 0, sizeof(*p));
+  initlock(&p->lock, "proc");
+
+  // map the stack high in memory, every mapping in
+  // kernel_pagetable being shared with the process kernel
+  // page tables. the page below it stays unmapped as a guard.
+  p->kstack = KSTACK(i);
+  if((stack = kalloc()) == 0){
+    freelock(&p->lock);
+    kmem_cache_free(proccache, p);
+    return 0;
   }
+  if(mappages(kernel_pagetable, p->kstack, PGSIZE, (uint64)stack, PTE_R | PTE_W) < 0){
+    kfree(stack);
+    freelock(&p->lock);
+    kmem_cache_free(proccache, p);
+    return 0;
+  }
+  // other CPUs flush p's ASIDs before they run it.
+  sfence_vma();
+
+  if(kvmasids()){
+    p->kasid = 2*i + 1;
+    p->uasid = p->kasid + 1;
+  }
+  procs[i] = p;
+  // p must be complete before procs[] readers see it.
+  __sync_synchronize();
+  nproc = i + 1;
+  return p;
 }
 
-// initialize the proc table at boot time.
+static struct sleepq*
+sleepqof(void *chan)
+{
+  return &sleepq[((uint64)chan >> 4) % NSLEEPQ];
+}
+
+// Make p RUNNABLE and queue it for the scheduler.
+// Caller must hold p->lock.
+static void
+setrunnable(struct proc *p)
+{
+  p->state = RUNNABLE;
+  p->next = 0;
+  acquire(&runq.lock);
+  if(runq.tail)
+    runq.tail->next = p;
+  else
+    runq.head = p;
+  runq.tail = p;
+  release(&runq.lock);
+}
+
+// ASIDs tag TLB entries with the address space they belong
+// to, so switching page tables doesn't have to flush the TLB.
+// A process's kernel and user page tables need different
+// ASIDs, since they map the kernel stacks and TRAPFRAME/RING
+// differently. A CPU must still flush a process's ASIDs before
+// running it if its page tables may have changed since the
+// CPU last did so; p->tlbgen changes whenever they do, and
+// c->tlbgen[] records what each CPU last flushed. Without
+// ASIDs (kasid == 0), every switch flushes the whole TLB.
+
+static uint64 tlbgen;
+
+// Flush p's translations from this CPU's TLB.
+static void
+asidfence(struct proc *p)
+{
+  if(p->kasid == 0){
+    sfence_vma();
+  } else {
+    sfence_vma_asid(p->kasid);
+    sfence_vma_asid(p->uasid);
+  }
+}
+
+// Call after changing p's page tables: flush this CPU's
+// TLB now, and make other CPUs flush before running p.
 void
-procinit(void)
+asidflush(struct proc *p)
 {
-  struct proc *p;
-  
-  initlock(&pid_lock, "nextpid");
-  initlock(&wait_lock, "wait_lock");
-  for(p = proc; p < &proc[NPROC]; p++) {
-      initlock(&p->lock, "proc");
-      p->kstack = KSTACK((int) (p - proc));
+  struct cpu *c;
+
+  push_off();
+  c = mycpu();
+  p->tlbgen = __sync_add_and_fetch(&tlbgen, 1);
+  asidfence(p);
+  p->flushgen[c - cpus] = p->tlbgen;
+  pop_off();
+}
+
+// Make sure this CPU's TLB holds nothing stale for p,
+// which it is about to run.
+static void
+asidcheck(struct cpu *c, struct proc *p)
+{
+  if(p->kasid == 0 || p->flushgen[c - cpus] != p->tlbgen){
+    asidfence(p);
+    p->flushgen[c - cpus] = p->tlbgen;
   }
 }
 
@@ -97,7 +233,7 @@ allocpid() {
   return pid;
 }
 
-// Look in the process table for an UNUSED proc.
+// Take an UNUSED proc, making one if there are none.
 // If found, initialize state required to run in the kernel,
 // and return with p->lock held.
 // If there are no free procs, or a memory allocation fails, return 0.
@@ -106,19 +242,28 @@ allocproc(void)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if(p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
-    }
-  }
-  return 0;
+  acquire(&ptable.lock);
+  if((p = ptable.free) != 0)
+    ptable.free = p->next;
+  else
+    p = newproc();
+  release(&ptable.lock);
+  if(p == 0)
+    return 0;
+  acquire(&p->lock);
 
-found:
   p->pid = allocpid();
   p->state = USED;
+  acquire(&pid_lock);
+  p->pidnext = pidhash[p->pid % NPIDHASH];
+  pidhash[p->pid % NPIDHASH] = p;
+  release(&pid_lock);
+  // no CPU has flushed this slot's ASIDs for this process yet.
+  p->tlbgen = __sync_add_and_fetch(&tlbgen, 1);
+  memset(p->sccount, 0, sizeof(p->sccount));
+  memset(p->sctime, 0, sizeof(p->sctime));
+  p->clockva = 0;
+  p->pinva = p->pinend = 0;
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -135,6 +280,13 @@ found:
     return 0;
   }
 
+  // A kernel page table, to hold user memory once there is some.
+  if((p->kpagetable = kvmcreate()) == 0){
+    freeproc(p);
+    release(&p->lock);
+    return 0;
+  }
+
   // Set up new context to start executing at forkret,
   // which returns to user space.
   memset(&p->context, 0, sizeof(p->context));
@@ -150,9 +302,22 @@ found:
 static void
 freeproc(struct proc *p)
 {
+  struct proc **pp;
+
+  if(p->pid){
+    acquire(&pid_lock);
+    for(pp = &pidhash[p->pid % NPIDHASH]; *pp != p; pp = &(*pp)->pidnext)
+      ;
+    *pp = p->pidnext;
+    release(&pid_lock);
+  }
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  ringfree(p);
+  if(p->kpagetable)
+    kvmfree(p->kpagetable);
+  p->kpagetable = 0;
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
@@ -164,6 +329,10 @@ freeproc(struct proc *p)
   p->killed = 0;
   p->xstate = 0;
   p->state = UNUSED;
+  acquire(&ptable.lock);
+  p->next = ptable.free;
+  ptable.free = p;
+  release(&ptable.lock);
 }
 
 // Create a user page table for a given process,
@@ -234,6 +403,7 @@ userinit(void)
   // and data into it.
   uvminit(p->pagetable, initcode, sizeof(initcode));
   p->sz = PGSIZE;
+  kvmsync(p->kpagetable, p->pagetable);
 
   // prepare for the very first "return" from kernel to user.
   p->trapframe->epc = 0;      // user program counter
@@ -242,9 +412,38 @@ userinit(void)
   safestrcpy(p->name, "initcode", sizeof(p->name));
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
+
+  release(&p->lock);
+}
 
+// Start a kernel thread, a process without user
+// memory that runs fn() in the kernel forever.
+void
+kthread(char *name, void (*fn)(void))
+{
+  struct proc *p;
+
+  if((p = allocproc()) == 0)
+    panic("kthread");
+  p->context.ra = (uint64)kthreadstart;
+  p->kfn = fn;
+  safestrcpy(p->name, name, sizeof(p->name));
+  setrunnable(p);
+  release(&p->lock);
+}
+
+// A kernel thread's first scheduling by scheduler()
+// will swtch here.
+static void
+kthreadstart(void)
+{
+  struct proc *p = myproc();
+
+  // Still holding p->lock from scheduler.
   release(&p->lock);
+  p->kfn();
+  panic("kthread returned");
 }
 
 // Grow or shrink user memory by n bytes.
@@ -255,15 +454,29 @@ growproc(int n)
   uint sz;
   struct proc *p = myproc();
 
+  vmlock(p);
   sz = p->sz;
   if(n > 0){
-    if((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+    if(sz + n > MAXUSER || (sz = uvmalloc(p->pagetable, sz, sz + n)) == 0){
+      vmunlock(p);
       return -1;
     }
+    kvmsync(p->kpagetable, p->pagetable);
   } else if(n < 0){
+    // the new end may fall inside a megapage, which must
+    // be split first; that needs a page, and can fail.
+    if(PGROUNDUP(sz + n) % MEGAPGSIZE != 0 &&
+       uvmsplit(p->pagetable, PGROUNDUP(sz + n)) < 0){
+      vmunlock(p);
+      return -1;
+    }
     sz = uvmdealloc(p->pagetable, sz, sz + n);
+    // a megapage's level-1 PTE may have changed.
+    kvmsync(p->kpagetable, p->pagetable);
   }
+  asidflush(p);
   p->sz = sz;
+  vmunlock(p);
   return 0;
 }
 
@@ -280,14 +493,22 @@ fork(void)
   if((np = allocproc()) == 0){
     return -1;
   }
+  // uvmcopy() may sleep for swap, so np->lock can't be
+  // held; nothing else uses np while it's USED.
+  release(&np->lock);
 
   // Copy user memory from parent to child.
+  vmlock(p);
   if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
+    vmunlock(p);
+    acquire(&np->lock);
     freeproc(np);
     release(&np->lock);
     return -1;
   }
+  vmunlock(p);
   np->sz = p->sz;
+  kvmsync(np->kpagetable, np->pagetable);
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -305,19 +526,88 @@ fork(void)
 
   pid = np->pid;
 
+  acquire(&wait_lock);
+  adopt(p, np);
+  release(&wait_lock);
+
+  acquire(&np->lock);
+  setrunnable(np);
+  release(&np->lock);
+
+  return pid;
+}
+
+// Create a new process running the program at path, without
+// copying the parent's memory the way fork() and exec() would.
+// The child's open files are ofile[0..NOFILE-1], where a null
+// entry is a closed descriptor. Returns the child's pid.
+int
+spawn(char *path, char **argv, struct file **ofile)
+{
+  int i, argc, pid;
+  struct proc *np;
+  struct proc *p = myproc();
+
+  if((np = allocproc()) == 0)
+    return -1;
+  // as in fork(), nothing else uses np while it's USED.
   release(&np->lock);
 
+  memset(np->trapframe, 0, sizeof(*np->trapframe));
+  if((argc = execproc(np, path, argv)) < 0){
+    acquire(&np->lock);
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+  // arguments to the child's main(argc, argv).
+  np->trapframe->a0 = argc;
+
+  for(i = 0; i < NOFILE; i++)
+    if(ofile[i])
+      np->ofile[i] = filedup(ofile[i]);
+  np->cwd = idup(p->cwd);
+
+  pid = np->pid;
+
   acquire(&wait_lock);
-  np->parent = p;
+  adopt(p, np);
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
 }
 
+// Make child one of parent's children.
+// Caller must hold wait_lock.
+static void
+adopt(struct proc *parent, struct proc *child)
+{
+  child->parent = parent;
+  child->sibprev = 0;
+  child->sibnext = parent->children;
+  if(parent->children)
+    parent->children->sibprev = child;
+  parent->children = child;
+}
+
+// Take child off its parent's list of children.
+// Caller must hold wait_lock.
+static void
+disown(struct proc *child)
+{
+  if(child->sibprev)
+    child->sibprev->sibnext = child->sibnext;
+  else
+    child->parent->children = child->sibnext;
+  if(child->sibnext)
+    child->sibnext->sibprev = child->sibprev;
+  child->parent = child->sibnext = child->sibprev = 0;
+}
+
 // Pass p's abandoned children to init.
 // Caller must hold wait_lock.
 void
@@ -325,12 +615,13 @@ reparent(struct proc *p)
 {
   struct proc *pp;
 
-  for(pp = proc; pp < &proc[NPROC]; pp++){
-    if(pp->parent == p){
-      pp->parent = initproc;
-      wakeup(initproc);
-    }
+  if(p->children == 0)
+    return;
+  while((pp = p->children) != 0){
+    disown(pp);
+    adopt(initproc, pp);
   }
+  wakeup(initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -358,6 +649,12 @@ exit(int status)
   end_op();
   p->cwd = 0;
 
+  // wait for swapout() to finish with our memory, if it's
+  // paging something out; it leaves running processes alone,
+  // so it won't start again before we're a zombie.
+  vmlock(p);
+  vmunlock(p);
+
   acquire(&wait_lock);
 
   // Give any children to init.
@@ -382,38 +679,48 @@ exit(int status)
 // Return -1 if this process has no children.
 int
 wait(uint64 addr)
+{
+  return waitpid(-1, addr, 0);
+}
+
+// Wait for child pid, or any child if pid is -1, to exit.
+// Return its pid, or -1 if there is no such child. With
+// WNOHANG in options, return 0 if it hasn't exited yet.
+int
+waitpid(int pid, uint64 addr, int options)
 {
   struct proc *np;
-  int havekids, pid;
+  int havekids, cpid;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
 
   for(;;){
-    // Scan through table looking for exited children.
+    // Scan through our children looking for exited ones.
     havekids = 0;
-    for(np = proc; np < &proc[NPROC]; np++){
-      if(np->parent == p){
-        // make sure the child isn't still in exit() or swtch().
-        acquire(&np->lock);
-
-        havekids = 1;
-        if(np->state == ZOMBIE){
-          // Found one.
-          pid = np->pid;
-          if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                  sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&wait_lock);
-            return -1;
-          }
-          freeproc(np);
+    for(np = p->children; np; np = np->sibnext){
+      if(pid != -1 && np->pid != pid)
+        continue;
+      // make sure the child isn't still in exit() or swtch().
+      acquire(&np->lock);
+
+      havekids = 1;
+      if(np->state == ZOMBIE){
+        // Found one.
+        cpid = np->pid;
+        if(addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                                sizeof(np->xstate)) < 0) {
           release(&np->lock);
           release(&wait_lock);
-          return pid;
+          return -1;
         }
+        disown(np);
+        freeproc(np);
         release(&np->lock);
+        release(&wait_lock);
+        return cpid;
       }
+      release(&np->lock);
     }
 
     // No point waiting if we don't have any children.
@@ -421,6 +728,10 @@ wait(uint64 addr)
       release(&wait_lock);
       return -1;
     }
+    if(options & WNOHANG){
+      release(&wait_lock);
+      return 0;
+    }
     
     // Wait for a child to exit.
     sleep(p, &wait_lock);  //DOC: wait-sleep
@@ -445,22 +756,42 @@ scheduler(void)
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-      }
-      release(&p->lock);
+    // look before taking the lock, so that idle CPUs
+    // don't queue up for it ahead of setrunnable().
+    if(__atomic_load_n(&runq.head, __ATOMIC_RELAXED) == 0)
+      continue;
+
+    acquire(&runq.lock);
+    if((p = runq.head) != 0){
+      runq.head = p->next;
+      if(runq.head == 0)
+        runq.tail = 0;
     }
+    release(&runq.lock);
+    if(p == 0)
+      continue;
+
+    // p may still be on its way into sched() on
+    // another CPU; p->lock waits for it to get there.
+    acquire(&p->lock);
+    if(p->state == RUNNABLE) {
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      p->state = RUNNING;
+      c->proc = p;
+      // run on p's kernel page table, which also maps
+      // its user memory.
+      w_satp(MAKE_SATP(p->kpagetable) | SATP_ASID(p->kasid));
+      asidcheck(c, p);
+      swtch(&c->context, &p->context);
+      kvmswitch();
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      c->proc = 0;
+    }
+    release(&p->lock);
   }
 }
 
@@ -475,6 +806,7 @@ void
 sched(void)
 {
   int intena;
+  uint64 sum;
   struct proc *p = myproc();
 
   if(!holding(&p->lock))
@@ -486,9 +818,18 @@ sched(void)
   if(intr_get())
     panic("sched interruptible");
 
+  // a timer interrupt can yield in the middle of copyuser(),
+  // with sstatus.SUM set. swtch() doesn't save sstatus, so
+  // clear SUM for whatever runs next, and set it again
+  // when this process gets the CPU back.
+  sum = r_sstatus() & SSTATUS_SUM;
+  w_sstatus(r_sstatus() & ~SSTATUS_SUM);
+
   intena = mycpu()->intena;
   swtch(&p->context, &mycpu()->context);
   mycpu()->intena = intena;
+
+  w_sstatus(r_sstatus() | sum);
 }
 
 // Give up the CPU for one scheduling round.
@@ -497,7 +838,7 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  setrunnable(p);
   sched();
   release(&p->lock);
 }
@@ -529,20 +870,25 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct sleepq *q = sleepqof(chan);
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
-  // Once we hold p->lock, we can be
+  // Once we hold q->lock, we can be
   // guaranteed that we won't miss any wakeup
-  // (wakeup locks p->lock),
+  // (wakeup locks q->lock),
   // so it's okay to release lk.
 
+  acquire(&q->lock);
   acquire(&p->lock);  //DOC: sleeplock1
   release(lk);
 
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->next = q->head;
+  q->head = p;
+  release(&q->lock);
 
   sched();
 
@@ -554,22 +900,61 @@ sleep(void *chan, struct spinlock *lk)
   acquire(lk);
 }
 
+// Wake up the processes sleeping on chan, or just
+// p if p isn't 0. Must be called without any p->lock.
+static void
+wakeq(void *chan, struct proc *only)
+{
+  struct sleepq *q = sleepqof(chan);
+  struct proc *p, **pp;
+
+  acquire(&q->lock);
+  // everything on q is SLEEPING, and its chan
+  // can't change until it's taken off.
+  pp = &q->head;
+  while((p = *pp) != 0){
+    if(p->chan != chan || (only && p != only)){
+      pp = &p->next;
+      continue;
+    }
+    *pp = p->next;
+    acquire(&p->lock);
+    setrunnable(p);
+    release(&p->lock);
+  }
+  release(&q->lock);
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void
 wakeup(void *chan)
+{
+  wakeq(chan, 0);
+}
+
+// Find the process with the given pid and return it
+// with p->lock held, or return 0 if there isn't one.
+static struct proc*
+findproc(int pid)
 {
   struct proc *p;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
-    if(p != myproc()){
-      acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-    }
+  if(pid <= 0)
+    return 0;
+  acquire(&pid_lock);
+  for(p = pidhash[pid % NPIDHASH]; p && p->pid != pid; p = p->pidnext)
+    ;
+  release(&pid_lock);
+  if(p == 0)
+    return 0;
+  acquire(&p->lock);
+  // it may have been freed since pid_lock was released.
+  if(p->pid != pid || p->state == UNUSED){
+    release(&p->lock);
+    return 0;
   }
+  return p;
 }
 
 // Kill the process with the given pid.
@@ -579,21 +964,34 @@ int
 kill(int pid)
 {
   struct proc *p;
+  void *chan = 0;
 
-  for(p = proc; p < &proc[NPROC]; p++){
-    acquire(&p->lock);
-    if(p->pid == pid){
-      p->killed = 1;
-      if(p->state == SLEEPING){
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
-      release(&p->lock);
-      return 0;
-    }
-    release(&p->lock);
-  }
-  return -1;
+  if((p = findproc(pid)) == 0)
+    return -1;
+  p->killed = 1;
+  if(p->state == SLEEPING)
+    chan = p->chan;
+  release(&p->lock);
+  // Wake process from sleep(), unless it has woken
+  // up and gone to sleep on something else since.
+  if(chan)
+    wakeq(chan, p);
+  return 0;
+}
+
+// Fetch process pid's counters for system call num.
+// Returns -1 if there's no such process.
+int
+procsyscallstat(int pid, int num, uint64 *count, uint64 *time)
+{
+  struct proc *p;
+
+  if((p = findproc(pid)) == 0)
+    return -1;
+  *count = p->sccount[num];
+  *time = p->sctime[num];
+  release(&p->lock);
+  return 0;
 }
 
 // Copy to either a user address, or kernel address,
@@ -641,9 +1039,11 @@ procdump(void)
   };
   struct proc *p;
   char *state;
+  int i;
 
   printf("\n");
-  for(p = proc; p < &proc[NPROC]; p++){
+  for(i = 0; i < nproc; i++){
+    p = procs[i];
     if(p->state == UNUSED)
       continue;
     if(p->state >= 0 && p->state < NELEM(states) && states[p->state])
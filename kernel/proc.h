@@ -26,6 +26,10 @@ struct cpu {
   int intena;                 // Were interrupts enabled before push_off()?
 };
 
+// ASIDs: 0 is kernel_pagetable's; each struct proc
+// has two more, for its kernel and user page tables.
+#define MAXASID (2*NPROC)
+
 extern struct cpu cpus[NCPU];
 
 // per-process data for the trap handling code in trampoline.S.
@@ -88,21 +92,46 @@ struct proc {
 
   // p->lock must be held when using these:
   enum procstate state;        // Process state
+  struct proc *next;           // on ptable.free, runq, or a sleep queue,
+                               // if UNUSED, RUNNABLE, or SLEEPING
   void *chan;                  // If non-zero, sleeping on chan
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
 
-  // wait_lock must be held when using this:
+  // wait_lock must be held when using these:
   struct proc *parent;         // Parent process
+  struct proc *children;       // first child
+  struct proc *sibnext;        // parent's other children
+  struct proc *sibprev;
+
+  // pid_lock must be held when using this:
+  struct proc *pidnext;        // next in pid hash chain
+
+  // the vm lock; see vmlock() in swap.c.
+  struct proc *vmholder;       // process holding it, or 0
+
+  // the vm lock must be held when using these:
+  uint64 clockva;              // where swapout() looks next
+  uint64 pinva, pinend;        // range swapout() leaves alone
 
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
+  pagetable_t kpagetable;      // Kernel page table, with user memory too
+  int kasid, uasid;            // ASIDs of kpagetable and pagetable, or 0
+  uint64 tlbgen;               // changes when the page tables do; see asidflush()
+  uint64 flushgen[NCPU];       // p->tlbgen when each CPU last flushed p's ASIDs
   struct trapframe *trapframe; // data page for trampoline.S
+  struct ring *ring;           // system call ring page, or 0
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
+  void (*kfn)(void);           // what a kernel thread runs
+
+  // per-process system call counters; see syscall().
+  uint64 sccount[NSYSCALL];    // calls
+  uint64 sctime[NSYSCALL];     // total time in each, in timer ticks
 };
@@ -0,0 +1,139 @@
+//
+// Sampling profiler: the timer interrupt records where
+// each CPU was, into a buffer per CPU; prof() reads them.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "prof.h"
+
+#define NPROFSAMPLE 2048   // per CPU; later samples are dropped
+
+extern uint64 timer_scratch[NCPU][5];  // start.c
+
+struct cpuprof {
+  struct spinlock lock;
+  int n;                   // samples in buf
+  int count;               // interrupts since the last clock tick
+  struct profsample buf[NPROFSAMPLE];
+};
+
+static struct {
+  int on;
+  uint64 interval;         // timer interval when not profiling
+  struct cpuprof cpu[NCPU];
+} prof;
+
+void
+profinit(void)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    initlock(&prof.cpu[i].lock, "prof");
+}
+
+// Set every CPU's timer interval; timervec
+// picks the new one up at its next interrupt.
+static void
+setinterval(uint64 interval)
+{
+  int i;
+
+  for(i = 0; i < NCPU; i++)
+    timer_scratch[i][4] = interval;
+}
+
+// Called by devintr() for each timer interrupt, with
+// interrupts off. Records a sample if profiling is on.
+// Returns 1 if this interrupt is also a clock tick,
+// which while profiling is every PROFRATE'th.
+int
+proftick(void)
+{
+  struct cpuprof *c = &prof.cpu[cpuid()];
+  struct proc *p = myproc();
+  struct profsample *s;
+
+  if(!prof.on){
+    c->count = 0;
+    return 1;
+  }
+
+  acquire(&c->lock);
+  if(c->n < NPROFSAMPLE){
+    s = &c->buf[c->n++];
+    s->pc = r_sepc();
+    s->user = (r_sstatus() & SSTATUS_SPP) == 0;
+    s->pid = p ? p->pid : 0;
+  }
+  release(&c->lock);
+
+  if(++c->count < PROFRATE)
+    return 0;
+  c->count = 0;
+  return 1;
+}
+
+// prof(cmd, addr, n): start or stop sampling, or move
+// up to n samples to the user array of struct profsample
+// at addr. PROF_READ returns the number moved; the others
+// return 0, or -1 on error.
+uint64
+sys_prof(void)
+{
+  struct cpuprof *c;
+  struct profsample s;
+  uint64 addr;
+  int cmd, n, got;
+
+  if(argint(0, &cmd) < 0 || argaddr(1, &addr) < 0 || argint(2, &n) < 0)
+    return -1;
+
+  switch(cmd){
+  case PROF_START:
+    for(c = prof.cpu; c < &prof.cpu[NCPU]; c++){
+      acquire(&c->lock);
+      c->n = 0;
+      release(&c->lock);
+    }
+    if(!prof.on){
+      prof.interval = timer_scratch[0][4];
+      prof.on = 1;
+      setinterval(prof.interval / PROFRATE);
+    }
+    return 0;
+
+  case PROF_STOP:
+    if(prof.on){
+      prof.on = 0;
+      setinterval(prof.interval);
+    }
+    return 0;
+
+  case PROF_READ:
+    got = 0;
+    for(c = prof.cpu; c < &prof.cpu[NCPU]; c++){
+      while(got < n){
+        // take from the end, so that nothing moves.
+        acquire(&c->lock);
+        if(c->n == 0){
+          release(&c->lock);
+          break;
+        }
+        s = c->buf[--c->n];
+        release(&c->lock);
+        if(copyout(myproc()->pagetable, addr + got*sizeof(s), (char*)&s, sizeof(s)) < 0)
+          return -1;
+        got++;
+      }
+    }
+    return got;
+  }
+  return -1;
+}
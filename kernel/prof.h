@@ -0,0 +1,18 @@
+// Sampling profiler.
+// Both the kernel and user programs use this header file.
+//
+// While profiling is on, each CPU's timer interrupts
+// PROFRATE times as often as usual, and each interrupt
+// records the program counter it interrupted.
+
+#define PROF_START 1   // discard old samples and start sampling
+#define PROF_STOP  2   // stop sampling
+#define PROF_READ  3   // copy out (and remove) samples
+
+#define PROFRATE 10    // samples per clock tick, per CPU
+
+struct profsample {
+  uint64 pc;     // interrupted sepc
+  int pid;       // process running then, or 0
+  int user;      // 1 if pc is a user address in process pid
+};
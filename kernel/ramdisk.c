@@ -12,34 +12,60 @@
 #include "fs.h"
 #include "buf.h"
 
-void
+static char *ramdisk;     // the image, or 0 if there is none
+static uint nblocks;      // its size in blocks
+
+// Use the image from qemu -initrd, if there is one.
+// Returns 1 if so, 0 if the kernel should use the
+// virtio disk instead.
+int
 ramdiskinit(void)
 {
+  uint64 start, end;
+
+  if(!fdtinitrd(&start, &end))
+    return 0;
+  if(start < KERNBASE || end > physend)
+    panic("ramdiskinit: image outside RAM");
+  ramdisk = (char*)start;
+  nblocks = (end - start) / BSIZE;
+  printf("ramdisk: %d blocks at %p\n", nblocks, ramdisk);
+  return 1;
 }
 
-// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
-// Else if B_VALID is not set, read buf from disk, set B_VALID.
+// Is the ramdisk in use?
+int
+ramdiskused(void)
+{
+  return ramdisk != 0;
+}
+
+// Give the memory holding blocks n and up, which
+// the file system doesn't use, to kalloc().
 void
-ramdiskrw(struct buf *b)
+ramdisktrim(uint n)
 {
+  if(n >= nblocks)
+    return;
+  freerange(ramdisk + (uint64)n*BSIZE, ramdisk + (uint64)nblocks*BSIZE);
+  nblocks = n;
+}
+
+// Read or write b, like virtio_disk_rw(), but
+// with a copy instead of a disk request.
+void
+ramdiskrw(struct buf *b, int write)
+{
+  char *addr;
+
   if(!holdingsleep(&b->lock))
     panic("ramdiskrw: buf not locked");
-  if((b->flags & (B_VALID|B_DIRTY)) == B_VALID)
-    panic("ramdiskrw: nothing to do");
-
-  if(b->blockno >= FSSIZE)
+  if(b->blockno >= nblocks)
     panic("ramdiskrw: blockno too big");
 
-  uint64 diskaddr = b->blockno * BSIZE;
-  char *addr = (char *)RAMDISK + diskaddr;
-
-  if(b->flags & B_DIRTY){
-    // write
+  addr = ramdisk + (uint64)b->blockno * BSIZE;
+  if(write)
     memmove(addr, b->data, BSIZE);
-    b->flags &= ~B_DIRTY;
-  } else {
-    // read
+  else
     memmove(b->data, addr, BSIZE);
-    b->flags |= B_VALID;
-  }
 }
@@ -0,0 +1,85 @@
+//
+// Shared-memory system call ring.
+// A process submits a batch of read/write/open/close
+// operations through a page mapped at RING in its
+// address space, and ringenter() runs all of them
+// in one trap instead of one trap per system call.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "ring.h"
+
+// Map a ring page into the current process.
+// Returns the ring's user address.
+uint64
+sys_ringsetup(void)
+{
+  struct proc *p = myproc();
+  char *mem;
+
+  if(p->ring)
+    return RING;
+
+  if((mem = kalloc()) == 0)
+    return -1;
+  pgzero(mem);
+  if(mappages(p->pagetable, RING, PGSIZE, (uint64)mem, PTE_R | PTE_W | PTE_U) < 0){
+    kfree(mem);
+    return -1;
+  }
+  p->ring = (struct ring*)mem;
+  asidflush(p);
+  return RING;
+}
+
+// Run up to n queued submissions, posting a completion
+// for each. Stops early if the completion queue is full.
+// Returns the number of submissions consumed.
+uint64
+sys_ringenter(void)
+{
+  struct proc *p = myproc();
+  struct ring *r = p->ring;
+  struct ringsqe e;
+  struct ringcqe *c;
+  int n, i;
+
+  if(argint(0, &n) < 0 || r == 0)
+    return -1;
+
+  for(i = 0; i < n && !p->killed; i++){
+    // the ring is shared with user code, so read each
+    // index exactly once and copy the entry before using it.
+    __sync_synchronize();
+    if(r->sqhead == r->sqtail || r->cqtail - r->cqhead >= NRING)
+      break;
+    e = r->sq[r->sqhead % NRING];
+    r->sqhead++;
+
+    c = &r->cq[r->cqtail % NRING];
+    c->data = e.data;
+    c->res = ringop(&e);
+
+    // make the completion visible before advancing cqtail.
+    __sync_synchronize();
+    r->cqtail++;
+  }
+  return i;
+}
+
+// Unmap and free p's ring, if it has one.
+void
+ringfree(struct proc *p)
+{
+  if(p->ring == 0)
+    return;
+  uvmunmap(p->pagetable, RING, 1, 1);
+  p->ring = 0;
+  asidflush(p);
+}
@@ -0,0 +1,40 @@
+// Shared-memory system call ring.
+// Both the kernel and user programs use this header file.
+//
+// ringsetup() maps one page holding a struct ring at RING in the
+// calling process. User code fills submission entries and advances
+// sqtail, then calls ringenter(), which runs the queued operations
+// in a single trap and posts one completion for each.
+
+#define RING_READ   1   // fileread(fd, addr, n)
+#define RING_WRITE  2   // filewrite(fd, addr, n)
+#define RING_OPEN   3   // open(addr, n), addr is the path
+#define RING_CLOSE  4   // close(fd)
+
+// submission queue entry.
+struct ringsqe {
+  int op;        // RING_*
+  int fd;
+  uint64 addr;   // user buffer or path
+  int n;         // byte count, or open mode
+  int pad;
+  uint64 data;   // copied unchanged into the completion
+};
+
+// completion queue entry.
+struct ringcqe {
+  uint64 data;   // from the submission
+  int res;       // what the system call would have returned
+  int pad;
+};
+
+#define NRING 64   // entries in each queue
+
+struct ring {
+  uint sqhead;   // next submission the kernel will consume
+  uint sqtail;   // next submission slot user code will fill
+  uint cqhead;   // next completion user code will reap
+  uint cqtail;   // next completion slot the kernel will fill
+  struct ringsqe sq[NRING];
+  struct ringcqe cq[NRING];
+};
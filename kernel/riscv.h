@@ -40,6 +40,7 @@ w_mepc(uint64 x)
 
 // Supervisor Status Register, sstatus
 
+#define SSTATUS_SUM (1L << 18) // Supervisor may access User Memory
 #define SSTATUS_SPP (1L << 8)  // Previous mode, 1=Supervisor, 0=User
 #define SSTATUS_SPIE (1L << 5) // Supervisor Previous Interrupt Enable
 #define SSTATUS_UPIE (1L << 4) // User Previous Interrupt Enable
@@ -198,6 +199,10 @@ w_pmpaddr0(uint64 x)
 
 #define MAKE_SATP(pagetable) (SATP_SV39 | (((uint64)pagetable) >> 12))
 
+// the address space ID field of satp.
+#define SATP_ASID(asid) (((uint64)(asid) & 0xFFFF) << 44)
+#define SATP2ASID(satp) (((satp) >> 44) & 0xFFFF)
+
 // supervisor address translation and protection;
 // holds the address of the page table.
 static inline void 
@@ -260,6 +265,25 @@ r_mcounteren()
   return x;
 }
 
+// Supervisor-mode Counter-Enable
+static inline void
+w_scounteren(uint64 x)
+{
+  asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+static inline uint64
+r_scounteren()
+{
+  uint64 x;
+  asm volatile("csrr %0, scounteren" : "=r" (x) );
+  return x;
+}
+
+#define COUNTEREN_CY (1L << 0) // cycle
+#define COUNTEREN_TM (1L << 1) // time
+#define COUNTEREN_IR (1L << 2) // instret
+
 // machine-mode cycle counter
 static inline uint64
 r_time()
@@ -331,6 +355,14 @@ sfence_vma()
   asm volatile("sfence.vma zero, zero");
 }
 
+// flush the TLB entries for one address space,
+// other than global ones.
+static inline void
+sfence_vma_asid(uint64 asid)
+{
+  asm volatile("sfence.vma zero, %0" : : "r" (asid));
+}
+
 
 #define PGSIZE 4096 // bytes per page
 #define PGSHIFT 12  // bits of offset within a page
@@ -343,6 +375,19 @@ sfence_vma()
 #define PTE_W (1L << 2)
 #define PTE_X (1L << 3)
 #define PTE_U (1L << 4) // 1 -> user can access
+#define PTE_G (1L << 5) // global: the same in every address space
+#define PTE_A (1L << 6) // accessed
+#define PTE_D (1L << 7) // dirty
+#define PTE_MEGA (1L << 8) // software: a level-1 leaf, mapping a megapage
+#define PTE_S (1L << 9) // software: not valid, the page is in swap
+
+// a swapped-out page's PTE holds its swap slot
+// where a valid PTE holds the physical page number.
+#define PTE2SLOT(pte) ((pte) >> 10)
+#define SLOT2PTE(slot) (((uint64)(slot)) << 10)
+
+// a megapage is mapped by one level-1 PTE.
+#define MEGAPGSIZE (PGSIZE * 512)
 
 // shift a physical address to the right place for a PTE.
 #define PA2PTE(pa) ((((uint64)pa) >> 12) << 10)
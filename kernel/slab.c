@@ -0,0 +1,314 @@
+// Slab allocator for small kernel objects.
+//
+// A kmem_cache hands out objects of one size, carved from
+// pages obtained with kalloc(). Each page (a slab) starts
+// with a struct slab and holds as many objects as fit after
+// it, so an object's slab is found by rounding its address
+// down to a page boundary. A slab with no objects in use
+// goes back to kalloc().
+//
+// Each CPU keeps a small stack of free objects for each
+// cache, so that most allocations and frees touch neither
+// the cache's lock nor any shared cache line. The stack is
+// refilled from, or drained to, the slabs half a stack at
+// a time.
+//
+// kmalloc() and kmfree() sit on top of caches of
+// power-of-two sizes, for objects without a cache of
+// their own.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "stat.h"
+
+#define NCACHE 24     // most caches
+#define NCPUOBJ 16    // free objects each CPU keeps per cache
+
+struct slab {
+  struct slab *next;  // on the cache's partial or full list
+  struct slab *prev;
+  struct kmem_cache *cache;
+  void *free;         // free objects in this slab
+  int inuse;          // objects not on free
+  int pad;
+};
+
+struct cpucache {
+  int n;              // objects in obj[]
+  void *obj[NCPUOBJ];
+  uint64 nalloc;      // statistics, summed by slabstat()
+  uint64 nfree;
+  uint64 nrefill;
+};
+
+struct kmem_cache {
+  struct spinlock lock;
+  char name[SLABNAME];
+  uint size;          // object size, rounded up to 8 bytes
+  uint perslab;       // objects per slab
+  struct slab *partial; // slabs with free objects
+  struct slab *full;    // slabs with none
+  uint nslab;
+  struct cpucache cpu[NCPU];
+};
+
+struct {
+  struct spinlock lock;
+  struct kmem_cache cache[NCACHE];
+  int n;
+} slabs;
+
+// kmalloc() sizes; bigger requests get a whole page.
+static uint kmsize[] = { 16, 32, 64, 128, 256, 512, 1024 };
+#define NKMSIZE (sizeof(kmsize)/sizeof(kmsize[0]))
+static struct kmem_cache *kmcache[NKMSIZE];
+
+static char *kmname[NKMSIZE] = {
+  "kmalloc-16", "kmalloc-32", "kmalloc-64", "kmalloc-128",
+  "kmalloc-256", "kmalloc-512", "kmalloc-1024",
+};
+
+void
+slabinit(void)
+{
+  int i;
+
+  initlock(&slabs.lock, "slabs");
+  for(i = 0; i < NKMSIZE; i++)
+    kmcache[i] = kmem_cache_create(kmname[i], kmsize[i]);
+}
+
+// Make a cache of objects of size bytes.
+// name is for slabstat(). Panics if there are
+// too many caches or the objects are too big.
+struct kmem_cache*
+kmem_cache_create(char *name, uint size)
+{
+  struct kmem_cache *c;
+
+  size = (size + 7) & ~7;
+  if(size < sizeof(void*) || size > PGSIZE - sizeof(struct slab))
+    panic("kmem_cache_create: size");
+
+  acquire(&slabs.lock);
+  if(slabs.n >= NCACHE)
+    panic("kmem_cache_create: too many");
+  c = &slabs.cache[slabs.n];
+  memset(c, 0, sizeof(*c));
+  initlock(&c->lock, "kmem_cache");
+  safestrcpy(c->name, name, sizeof(c->name));
+  c->size = size;
+  c->perslab = (PGSIZE - sizeof(struct slab)) / size;
+  // the new cache must be complete before slabstat() sees it.
+  __sync_synchronize();
+  slabs.n++;
+  release(&slabs.lock);
+  return c;
+}
+
+static void
+slabpush(struct slab **list, struct slab *s)
+{
+  s->prev = 0;
+  s->next = *list;
+  if(*list)
+    (*list)->prev = s;
+  *list = s;
+}
+
+static void
+slabremove(struct slab **list, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    *list = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+  s->next = s->prev = 0;
+}
+
+// Get a new slab for c from kalloc().
+// Caller must hold c->lock.
+static struct slab*
+slabgrow(struct kmem_cache *c)
+{
+  struct slab *s;
+  char *obj;
+  int i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->cache = c;
+  s->inuse = 0;
+  s->free = 0;
+  obj = (char*)(s + 1) + (c->perslab - 1) * c->size;
+  for(i = 0; i < c->perslab; i++, obj -= c->size){
+    *(void**)obj = s->free;
+    s->free = obj;
+  }
+  slabpush(&c->partial, s);
+  c->nslab++;
+  return s;
+}
+
+// Move up to NCPUOBJ/2 objects from c's slabs to cc.
+// Called with interrupts off.
+static void
+refill(struct kmem_cache *c, struct cpucache *cc)
+{
+  struct slab *s;
+  void *obj;
+
+  acquire(&c->lock);
+  while(cc->n < NCPUOBJ/2){
+    if((s = c->partial) == 0 && (s = slabgrow(c)) == 0)
+      break;
+    obj = s->free;
+    s->free = *(void**)obj;
+    s->inuse++;
+    if(s->free == 0){
+      slabremove(&c->partial, s);
+      slabpush(&c->full, s);
+    }
+    cc->obj[cc->n++] = obj;
+  }
+  release(&c->lock);
+  cc->nrefill++;
+}
+
+// Give the newest NCPUOBJ/2 objects in cc back to
+// their slabs. Called with interrupts off.
+static void
+drain(struct kmem_cache *c, struct cpucache *cc)
+{
+  struct slab *s;
+  void *obj;
+
+  acquire(&c->lock);
+  while(cc->n > NCPUOBJ/2){
+    obj = cc->obj[--cc->n];
+    s = (struct slab*)PGROUNDDOWN((uint64)obj);
+    if(s->free == 0){
+      slabremove(&c->full, s);
+      slabpush(&c->partial, s);
+    }
+    *(void**)obj = s->free;
+    s->free = obj;
+    if(--s->inuse == 0){
+      slabremove(&c->partial, s);
+      c->nslab--;
+      kfree(s);
+    }
+  }
+  release(&c->lock);
+}
+
+// Allocate an object from c.
+// Returns 0 if memory is exhausted.
+void*
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct cpucache *cc;
+  void *obj = 0;
+
+  push_off();
+  cc = &c->cpu[cpuid()];
+  if(cc->n == 0)
+    refill(c, cc);
+  if(cc->n > 0){
+    obj = cc->obj[--cc->n];
+    cc->nalloc++;
+  }
+  pop_off();
+
+  if(obj)
+    memset(obj, 5, c->size); // fill with junk
+  return obj;
+}
+
+// Free an object that came from kmem_cache_alloc(c).
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct cpucache *cc;
+  struct slab *s;
+
+  s = (struct slab*)PGROUNDDOWN((uint64)obj);
+  if((uint64)obj < (uint64)(s + 1) || s->cache != c)
+    panic("kmem_cache_free");
+
+  // Fill with junk to catch dangling refs.
+  memset(obj, 1, c->size);
+
+  push_off();
+  cc = &c->cpu[cpuid()];
+  if(cc->n == NCPUOBJ)
+    drain(c, cc);
+  cc->obj[cc->n++] = obj;
+  cc->nfree++;
+  pop_off();
+}
+
+// Allocate n bytes of kernel memory.
+// Returns 0 if n is more than a page or
+// memory is exhausted.
+void*
+kmalloc(uint n)
+{
+  int i;
+
+  for(i = 0; i < NKMSIZE; i++)
+    if(n <= kmsize[i])
+      return kmem_cache_alloc(kmcache[i]);
+  if(n <= PGSIZE)
+    return kalloc();
+  return 0;
+}
+
+// Free memory from kmalloc().
+void
+kmfree(void *p)
+{
+  struct slab *s;
+
+  // objects never start a page, so a page-aligned
+  // pointer must be a whole page from kalloc().
+  if((uint64)p % PGSIZE == 0){
+    kfree(p);
+    return;
+  }
+  s = (struct slab*)PGROUNDDOWN((uint64)p);
+  kmem_cache_free(s->cache, p);
+}
+
+// Fill in st with the statistics for cache number i.
+// Returns 0, or -1 if there is no cache i.
+int
+slabstat(int i, struct slabstat *st)
+{
+  struct kmem_cache *c;
+  struct cpucache *cc;
+
+  if(i < 0 || i >= slabs.n)
+    return -1;
+  c = &slabs.cache[i];
+  memset(st, 0, sizeof(*st));
+  safestrcpy(st->name, c->name, sizeof(st->name));
+  st->size = c->size;
+  st->perslab = c->perslab;
+  st->nslab = c->nslab;
+  // the per-CPU counters are read without locks,
+  // so the sums are only approximate.
+  for(cc = c->cpu; cc < &c->cpu[NCPU]; cc++){
+    st->nalloc += cc->nalloc;
+    st->nfree += cc->nfree;
+    st->nrefill += cc->nrefill;
+    st->ncached += cc->n;
+  }
+  return 0;
+}
@@ -15,6 +15,8 @@ initsleeplock(struct sleeplock *lk, char *name)
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->readers = 0;
+  lk->writers = 0;
   lk->pid = 0;
 }
 
@@ -22,9 +24,11 @@ void
 acquiresleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
-  while (lk->locked) {
+  lk->writers++;
+  while (lk->locked || lk->readers) {
     sleep(lk, &lk->lk);
   }
+  lk->writers--;
   lk->locked = 1;
   lk->pid = myproc()->pid;
   release(&lk->lk);
@@ -40,6 +44,31 @@ releasesleep(struct sleeplock *lk)
   release(&lk->lk);
 }
 
+// Acquire lk shared with other readers.
+// Waits while it is held, or wanted, exclusively,
+// so that a stream of readers can't starve a writer.
+void
+acquiresleepshared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  while (lk->locked || lk->writers) {
+    sleep(lk, &lk->lk);
+  }
+  lk->readers++;
+  release(&lk->lk);
+}
+
+void
+releasesleepshared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  if(lk->readers < 1)
+    panic("releasesleepshared");
+  if(--lk->readers == 0)
+    wakeup(lk);
+  release(&lk->lk);
+}
+
 int
 holdingsleep(struct sleeplock *lk)
 {
@@ -51,5 +80,15 @@ holdingsleep(struct sleeplock *lk)
   return r;
 }
 
+// Is lk held shared by someone? Readers aren't recorded
+// individually, so this can't say whether it's the caller.
+int
+holdingsleepshared(struct sleeplock *lk)
+{
+  int r;
 
-
+  acquire(&lk->lk);
+  r = lk->readers > 0;
+  release(&lk->lk);
+  return r;
+}
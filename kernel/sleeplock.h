@@ -1,6 +1,10 @@
 // Long-term locks for processes
+// Held either by one process exclusively, or shared by
+// any number of readers.
 struct sleeplock {
-  uint locked;       // Is the lock held?
+  uint locked;       // Is the lock held exclusively?
+  int readers;       // Number of processes sharing it
+  int writers;       // Exclusive waiters; new readers hold off
   struct spinlock lk; // spinlock protecting this sleep lock
   
   // For debugging:
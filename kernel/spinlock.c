@@ -7,6 +7,74 @@
 #include "riscv.h"
 #include "proc.h"
 #include "defs.h"
+#include "stat.h"
+
+// Contention counters, one set per lock name, so that
+// e.g. all the per-process locks add up together. Each
+// CPU has its own sets, which only it writes, with
+// interrupts off, so acquire() needs no atomic adds and
+// CPUs don't share the counters' cache lines; lockstat()
+// adds them up.
+struct lockcount {
+  uint64 nacquire;   // acquire() calls
+  uint64 ncontend;   // acquire()s that had to wait
+  uint64 nspin;      // times round the wait loops
+  uint64 maxhold;    // longest time held, in r_time() ticks
+};
+
+// the last set counts all the names that don't fit.
+#define NLOCKCOUNT 32
+#define OTHERLOCKS (NLOCKCOUNT - 1)
+
+static struct {
+  uint locked;       // a bare flag: a spinlock would count itself
+  int n;             // names in use
+  char *name[NLOCKCOUNT];
+  int nlocks[NLOCKCOUNT];  // live locks with each name
+} locknames;
+
+static struct lockcount lockcounts[NCPU][NLOCKCOUNT]
+  __attribute__((aligned(64)));
+
+static void
+locknameslock(void)
+{
+  push_off();
+  while(__sync_lock_test_and_set(&locknames.locked, 1) != 0)
+    ;
+  __sync_synchronize();
+}
+
+static void
+locknamesunlock(void)
+{
+  __sync_lock_release(&locknames.locked);
+  pop_off();
+}
+
+// Find or make the counters for name, and count
+// one more lock with it. Returns their index.
+static int
+lockcount(char *name)
+{
+  int i;
+
+  locknameslock();
+  for(i = 0; i < locknames.n; i++)
+    if(i != OTHERLOCKS && strncmp(locknames.name[i], name, LOCKNAME) == 0)
+      break;
+  if(i == locknames.n){
+    if(i > OTHERLOCKS){
+      i = OTHERLOCKS;
+    } else {
+      locknames.name[i] = i == OTHERLOCKS ? "(other)" : name;
+      locknames.n++;
+    }
+  }
+  locknames.nlocks[i]++;
+  locknamesunlock();
+  return i;
+}
 
 void
 initlock(struct spinlock *lk, char *name)
@@ -14,6 +82,32 @@ initlock(struct spinlock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->cpu = 0;
+  lk->ticket = 0;
+  lk->next = 0;
+  lk->owner = 0;
+  lk->start = 0;
+  lk->countid = lockcount(name);
+}
+
+// Say that lk, which no one holds, is about to be freed,
+// so that lockstat() counts only the locks that exist.
+void
+freelock(struct spinlock *lk)
+{
+  locknameslock();
+  locknames.nlocks[lk->countid]--;
+  locknamesunlock();
+}
+
+// Like initlock(), but waiting CPUs take turns in the
+// order they arrived instead of racing for the lock each
+// time it's released, so none can starve. For heavily
+// contended locks.
+void
+initticketlock(struct spinlock *lk, char *name)
+{
+  initlock(lk, name);
+  lk->ticket = 1;
 }
 
 // Acquire the lock.
@@ -21,16 +115,28 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  struct lockcount *c;
+  uint64 spins = 0;
+  uint t;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
-  //   a5 = 1
-  //   s1 = &lk->locked
-  //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  if(lk->ticket){
+    // take a ticket, then wait for it to come up.
+    t = __sync_fetch_and_add(&lk->next, 1);
+    while(__atomic_load_n(&lk->owner, __ATOMIC_RELAXED) != t)
+      spins++;
+    lk->locked = 1;
+  } else {
+    // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+    //   a5 = 1
+    //   s1 = &lk->locked
+    //   amoswap.w.aq a5, a5, (s1)
+    while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+      spins++;
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,15 +146,31 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+  lk->start = r_time();
+  c = &lockcounts[cpuid()][lk->countid];
+  c->nacquire++;
+  if(spins){
+    c->ncontend++;
+    c->nspin += spins;
+  }
 }
 
 // Release the lock.
 void
 release(struct spinlock *lk)
 {
+  struct lockcount *c;
+  uint64 held;
+
   if(!holding(lk))
     panic("release");
 
+  // the holder acquired lk on this CPU.
+  held = r_time() - lk->start;
+  c = &lockcounts[cpuid()][lk->countid];
+  if(held > c->maxhold)
+    c->maxhold = held;
+
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -68,6 +190,10 @@ release(struct spinlock *lk)
   //   amoswap.w zero, zero, (s1)
   __sync_lock_release(&lk->locked);
 
+  // let the next ticket holder in. only the holder writes owner.
+  if(lk->ticket)
+    __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
+
   pop_off();
 }
 
@@ -81,6 +207,34 @@ holding(struct spinlock *lk)
   return r;
 }
 
+// Add up the i'th set of lock counters from all
+// CPUs into *st. The last set, named "(other)", has
+// the counters for names that didn't get their own.
+// Returns -1 if there is no i'th set.
+int
+lockstat(int i, struct lockstat *st)
+{
+  struct lockcount *c;
+  int id;
+
+  if(i < 0 || i >= locknames.n)
+    return -1;
+  locknameslock();
+  safestrcpy(st->name, locknames.name[i], LOCKNAME);
+  st->nlocks = locknames.nlocks[i];
+  locknamesunlock();
+  st->nacquire = st->ncontend = st->nspin = st->maxhold = 0;
+  for(id = 0; id < NCPU; id++){
+    c = &lockcounts[id][i];
+    st->nacquire += c->nacquire;
+    st->ncontend += c->ncontend;
+    st->nspin += c->nspin;
+    if(c->maxhold > st->maxhold)
+      st->maxhold = c->maxhold;
+  }
+  return 0;
+}
+
 // push_off/pop_off are like intr_off()/intr_on() except that they are matched:
 // it takes two pop_off()s to undo two push_off()s.  Also, if interrupts
 // are initially off, then push_off, pop_off leaves them off.
@@ -2,8 +2,14 @@
 struct spinlock {
   uint locked;       // Is the lock held?
 
+  // For ticket locks (see initticketlock()):
+  int ticket;        // Hand the lock out in arrival order?
+  uint next;         // Next ticket to give out.
+  uint owner;        // Ticket now allowed to hold the lock.
+
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+  int countid;       // Index of this name's counters.
+  uint64 start;      // When the holder acquired it, from r_time().
 };
-
@@ -16,10 +16,18 @@ uint64 timer_scratch[NCPU][5];
 // assembly code in kernelvec.S for machine-mode timer interrupt.
 extern void timervec();
 
-// entry.S jumps here in machine mode on stack0.
+// physical address of the flattened device tree, for fdt.c.
+uint64 fdtaddr;
+
+// entry.S jumps here in machine mode on stack0,
+// with qemu's boot arguments: a0 is the hartid,
+// a1 the device tree's address.
 void
-start()
+start(uint64 hartid, uint64 fdt)
 {
+  if(hartid == 0)
+    fdtaddr = fdt;
+
   // set M Previous Privilege mode to Supervisor, for mret.
   unsigned long x = r_mstatus();
   x &= ~MSTATUS_MPP_MASK;
@@ -43,6 +51,11 @@ start()
   w_pmpaddr0(0x3fffffffffffffull);
   w_pmpcfg0(0xf);
 
+  // let supervisor and user mode read the cycle, time,
+  // and instret counters, for benchmarks.
+  w_mcounteren(r_mcounteren() | COUNTEREN_CY | COUNTEREN_TM | COUNTEREN_IR);
+  w_scounteren(r_scounteren() | COUNTEREN_CY | COUNTEREN_TM | COUNTEREN_IR);
+
   // ask for clock interrupts.
   timerinit();
 
@@ -9,3 +9,59 @@ struct stat {
   short nlink; // Number of links to file
   uint64 size; // Size of file in bytes
 };
+
+// directory name cache counters, from dcachestat().
+struct dcachestat {
+  uint64 hits;     // lookups answered from the cache
+  uint64 neghits;  // lookups answered "not present" from the cache
+  uint64 misses;   // lookups that had to read the directory
+};
+
+#define NSCHIST 24
+
+// counters for one system call, from syscallstat().
+struct syscallstat {
+  char name[16];
+  uint64 count;          // calls
+  uint64 time;           // total time in the call, in timer ticks
+  uint64 hist[NSCHIST];  // calls taking [2^i, 2^(i+1)) ticks (hist[0]: < 2)
+};
+
+#define LOCKNAME 16
+
+// spinlock counters for one lock name, from lockstat().
+struct lockstat {
+  char name[LOCKNAME];
+  uint nlocks;       // live locks with this name
+  uint64 nacquire;   // acquisitions
+  uint64 ncontend;   // acquisitions that had to wait
+  uint64 nspin;      // wait loop iterations
+  uint64 maxhold;    // longest hold, in timer ticks (10 MHz on qemu)
+};
+
+#define SLABNAME 16
+
+// usage of one kernel object cache, from slabstat().
+struct slabstat {
+  char name[SLABNAME];
+  uint size;         // object size in bytes
+  uint perslab;      // objects per page
+  uint nslab;        // pages held
+  uint ncached;      // free objects in per-CPU caches
+  uint64 nalloc;     // allocations
+  uint64 nfree;      // frees
+  uint64 nrefill;    // allocations that missed the per-CPU cache
+};
+
+#define MAXORDER 10  // largest physical block is 2^MAXORDER pages
+
+// free physical memory, from memstat().
+struct memstat {
+  uint64 npage;               // pages managed by the allocator
+  uint64 nfree;               // pages free
+  uint nblock[MAXORDER+1];    // free blocks of 2^i pages
+  uint64 nswap;               // pages of swap space, or 0
+  uint64 swapused;            // pages in swap
+  uint64 pageout;             // pages written to swap
+  uint64 pagein;              // pages read back
+};
@@ -1,13 +1,40 @@
 #include "types.h"
+#include "riscv.h"
+
+// memset(), memcmp(), and memmove() work a 64-bit word at a
+// time, eight words per loop iteration, once dst (and src)
+// are word-aligned. When src and dst can't both be aligned
+// they fall back to bytes.
+
+#define WSIZE sizeof(uint64)
+
+#define ALIGNED(p) (((uint64)(p) & (WSIZE-1)) == 0)
+#define COALIGNED(p, q) ((((uint64)(p) ^ (uint64)(q)) & (WSIZE-1)) == 0)
 
 void*
 memset(void *dst, int c, uint n)
 {
-  char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  uchar *d = dst;
+  uint64 w, *wd;
+
+  for(; n > 0 && !ALIGNED(d); n--)
+    *d++ = c;
+
+  w = (uchar)c;
+  w |= w << 8;
+  w |= w << 16;
+  w |= w << 32;
+  wd = (uint64*)d;
+  for(; n >= 8*WSIZE; n -= 8*WSIZE, wd += 8){
+    wd[0] = w; wd[1] = w; wd[2] = w; wd[3] = w;
+    wd[4] = w; wd[5] = w; wd[6] = w; wd[7] = w;
   }
+  for(; n >= WSIZE; n -= WSIZE)
+    *wd++ = w;
+
+  d = (uchar*)wd;
+  while(n-- > 0)
+    *d++ = c;
   return dst;
 }
 
@@ -18,6 +45,17 @@ memcmp(const void *v1, const void *v2, uint n)
 
   s1 = v1;
   s2 = v2;
+  if(COALIGNED(s1, s2)){
+    for(; n > 0 && !ALIGNED(s1); n--, s1++, s2++){
+      if(*s1 != *s2)
+        return *s1 - *s2;
+    }
+    // skip equal words; the byte loop finds the difference.
+    for(; n >= WSIZE && *(uint64*)s1 == *(uint64*)s2; n -= WSIZE){
+      s1 += WSIZE;
+      s2 += WSIZE;
+    }
+  }
   while(n-- > 0){
     if(*s1 != *s2)
       return *s1 - *s2;
@@ -30,8 +68,10 @@ memcmp(const void *v1, const void *v2, uint n)
 void*
 memmove(void *dst, const void *src, uint n)
 {
-  const char *s;
-  char *d;
+  const uchar *s;
+  uchar *d;
+  uint64 *wd, w0, w1, w2, w3, w4, w5, w6, w7;
+  const uint64 *ws;
 
   if(n == 0)
     return dst;
@@ -39,13 +79,43 @@ memmove(void *dst, const void *src, uint n)
   s = src;
   d = dst;
   if(s < d && s + n > d){
+    // overlapping, with dst above src: copy from the end.
     s += n;
     d += n;
+    if(COALIGNED(s, d)){
+      for(; n > 0 && !ALIGNED(d); n--)
+        *--d = *--s;
+      ws = (const uint64*)s;
+      wd = (uint64*)d;
+      for(; n >= WSIZE; n -= WSIZE)
+        *--wd = *--ws;
+      s = (const uchar*)ws;
+      d = (uchar*)wd;
+    }
     while(n-- > 0)
       *--d = *--s;
-  } else
+  } else {
+    if(COALIGNED(s, d)){
+      for(; n > 0 && !ALIGNED(d); n--)
+        *d++ = *s++;
+      ws = (const uint64*)s;
+      wd = (uint64*)d;
+      // load all eight words before storing any, in case
+      // dst is just below src.
+      for(; n >= 8*WSIZE; n -= 8*WSIZE, ws += 8, wd += 8){
+        w0 = ws[0]; w1 = ws[1]; w2 = ws[2]; w3 = ws[3];
+        w4 = ws[4]; w5 = ws[5]; w6 = ws[6]; w7 = ws[7];
+        wd[0] = w0; wd[1] = w1; wd[2] = w2; wd[3] = w3;
+        wd[4] = w4; wd[5] = w5; wd[6] = w6; wd[7] = w7;
+      }
+      for(; n >= WSIZE; n -= WSIZE)
+        *wd++ = *ws++;
+      s = (const uchar*)ws;
+      d = (uchar*)wd;
+    }
     while(n-- > 0)
       *d++ = *s++;
+  }
 
   return dst;
 }
@@ -57,6 +127,34 @@ memcpy(void *dst, const void *src, uint n)
   return memmove(dst, src, n);
 }
 
+// Zero the page-aligned page pa.
+void
+pgzero(void *pa)
+{
+  uint64 *p = pa, *e = p + PGSIZE/WSIZE;
+
+  for(; p < e; p += 8){
+    p[0] = 0; p[1] = 0; p[2] = 0; p[3] = 0;
+    p[4] = 0; p[5] = 0; p[6] = 0; p[7] = 0;
+  }
+}
+
+// Copy the page-aligned page src to dst.
+void
+pgcopy(void *dst, const void *src)
+{
+  uint64 *d = dst, *e = d + PGSIZE/WSIZE;
+  const uint64 *s = src;
+  uint64 w0, w1, w2, w3, w4, w5, w6, w7;
+
+  for(; d < e; d += 8, s += 8){
+    w0 = s[0]; w1 = s[1]; w2 = s[2]; w3 = s[3];
+    w4 = s[4]; w5 = s[5]; w6 = s[6]; w7 = s[7];
+    d[0] = w0; d[1] = w1; d[2] = w2; d[3] = w3;
+    d[4] = w4; d[5] = w5; d[6] = w6; d[7] = w7;
+  }
+}
+
 int
 strncmp(const char *p, const char *q, uint n)
 {
@@ -0,0 +1,406 @@
+// Paging user memory out to swap.
+//
+// The swap area follows the file system on the disk (see
+// mkfs), divided into page-sized slots. When kalloc() runs
+// dry, swapalloc() writes a user page to a free slot and
+// frees it; the swapd kernel thread does the same ahead of
+// time whenever free memory runs low. The victim's PTE keeps
+// its permissions but gets PTE_S instead of PTE_V, and the
+// slot number instead of a physical page number. A page fault
+// on it (usertrap(), or copyin() and friends) reads it back.
+//
+// Victims are chosen with the clock algorithm: a hand sweeps
+// over each process's memory, giving a page whose accessed
+// bit (PTE_A) is set a second chance by clearing the bit, and
+// taking the first page whose bit is clear. A megapage that
+// the hand reaches is split into ordinary pages first.
+//
+// A process's page table may change under it only while
+// something holds its vm lock (vmlock()), which the process
+// itself takes to change its memory, and swapout() takes to
+// page out one of another process's pages. swapout() only
+// chooses processes that aren't running, and clears the
+// victim's PTE_V before the process can run again, so the
+// process can't see the page change while it is written out.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+#include "defs.h"
+#include "fs.h"
+#include "buf.h"
+#include "stat.h"
+
+#define BPP (PGSIZE / BSIZE)      // blocks per slot
+#define NSLOT (SWAPSIZE / BPP)    // most slots
+#define SWAPLOW 64                // swapd starts below this many free pages,
+#define SWAPHIGH 256              // and stops at this many
+#define SCANMAX 4096              // most PTEs pick() looks at
+
+extern struct proc *procs[NPROC];
+extern int nproc;
+
+struct {
+  struct spinlock lock;
+  uint dev;
+  uint start;         // first block of the swap area
+  int nslot;          // 0 if there's no swap
+  char used[NSLOT];
+  int nused;
+  int next;           // where slotalloc() looks first
+  int hand;           // next process for swapout() to try
+  uint64 nout;        // statistics for swapstat()
+  uint64 nin;
+} swap;
+
+// swap I/O goes through this buffer, a block at a
+// time; its lock serializes it.
+static struct buf iobuf;
+
+// guards every p->vmholder.
+static struct spinlock vmlk;
+
+void
+swapinit(void)
+{
+  initlock(&swap.lock, "swap");
+  initlock(&vmlk, "vm");
+  initsleeplock(&iobuf.lock, "swapio");
+}
+
+// Start paging to the swap area of the file system
+// on dev, whose superblock is sb.
+void
+swapon(uint dev, struct superblock *sb)
+{
+  if(sb->nswap == 0)
+    return;
+  // swapping to the ramdisk would just move pages from one
+  // part of memory to another, so free its swap area instead.
+  if(ramdiskused()){
+    ramdisktrim(sb->swapstart);
+    return;
+  }
+  swap.dev = dev;
+  swap.start = sb->swapstart;
+  swap.nslot = sb->nswap / BPP;
+  if(swap.nslot > NSLOT)
+    swap.nslot = NSLOT;
+}
+
+// Take p's vm lock, waiting for whoever holds it.
+void
+vmlock(struct proc *p)
+{
+  acquire(&vmlk);
+  while(p->vmholder)
+    sleep(&p->vmholder, &vmlk);
+  p->vmholder = myproc();
+  release(&vmlk);
+}
+
+// Take p's vm lock if no one holds it.
+// Returns 1 if it did, 0 if not.
+static int
+vmtrylock(struct proc *p)
+{
+  int ok = 0;
+
+  acquire(&vmlk);
+  if(p->vmholder == 0){
+    p->vmholder = myproc();
+    ok = 1;
+  }
+  release(&vmlk);
+  return ok;
+}
+
+void
+vmunlock(struct proc *p)
+{
+  acquire(&vmlk);
+  if(p->vmholder != myproc())
+    panic("vmunlock");
+  p->vmholder = 0;
+  wakeup(&p->vmholder);
+  release(&vmlk);
+}
+
+static int
+slotalloc(void)
+{
+  int i, s;
+
+  acquire(&swap.lock);
+  for(i = 0; i < swap.nslot; i++){
+    s = (swap.next + i) % swap.nslot;
+    if(!swap.used[s]){
+      swap.used[s] = 1;
+      swap.nused++;
+      swap.next = s + 1;
+      release(&swap.lock);
+      return s;
+    }
+  }
+  release(&swap.lock);
+  return -1;
+}
+
+void
+slotfree(int s)
+{
+  acquire(&swap.lock);
+  if(s < 0 || s >= swap.nslot || !swap.used[s])
+    panic("slotfree");
+  swap.used[s] = 0;
+  swap.nused--;
+  release(&swap.lock);
+}
+
+// Read or write the page at mem from or to slot s.
+static void
+swaprw(int s, char *mem, int write)
+{
+  int i;
+
+  acquiresleep(&iobuf.lock);
+  iobuf.dev = swap.dev;
+  for(i = 0; i < BPP; i++){
+    iobuf.blockno = swap.start + s*BPP + i;
+    if(write)
+      memmove(iobuf.data, mem + i*BSIZE, BSIZE);
+    virtio_disk_rw(&iobuf, write);
+    if(!write)
+      memmove(mem + i*BSIZE, iobuf.data, BSIZE);
+  }
+  releasesleep(&iobuf.lock);
+}
+
+// Copy slot s into the page at mem, leaving
+// the slot in use. For uvmcopy().
+void
+swapread(int s, char *mem)
+{
+  swaprw(s, mem, 0);
+}
+
+// Choose a page of p's to page out, with the clock algorithm,
+// and clear its PTE_V. Returns its PTE, or 0 if there's no
+// page to take. Caller must hold p's vm lock and p->lock.
+static pte_t*
+pick(struct proc *p)
+{
+  pte_t *pte, *victim = 0, *spare = 0;
+  uint64 va, sz = PGROUNDDOWN(p->sz);
+  int n, split = 0;
+
+  if(sz == 0)
+    return 0;
+  va = p->clockva < sz ? p->clockva : 0;
+  for(n = 0; n < 2*(sz/PGSIZE) && n < SCANMAX; n++){
+    if(va >= sz)
+      va = 0;
+    pte = walk(p->pagetable, va, 0);
+    if(pte && (*pte & PTE_MEGA) && uvmsplit(p->pagetable, va) == 0){
+      kvmsync(p->kpagetable, p->pagetable);
+      split = 1;
+      pte = walk(p->pagetable, va, 0);
+    }
+    if(pte == 0 || (*pte & PTE_MEGA)){
+      // skip the rest of this 2MB.
+      va = (va + MEGAPGSIZE) & ~(MEGAPGSIZE-1);
+      continue;
+    }
+    if((*pte & (PTE_V|PTE_U)) != (PTE_V|PTE_U) ||
+       (va >= p->pinva && va < p->pinend)){
+      va += PGSIZE;
+      continue;
+    }
+    if((*pte & PTE_A) == 0){
+      victim = pte;
+      break;
+    }
+    *pte &= ~PTE_A;
+    if(spare == 0)
+      spare = pte;
+    va += PGSIZE;
+  }
+  if(victim == 0)
+    victim = spare;
+  p->clockva = va + PGSIZE;
+  if(victim)
+    *victim &= ~PTE_V;
+  if(victim || split)
+    asidflush(p);
+  return victim;
+}
+
+// Write one user page to swap and free it.
+// Returns 0, or -1 if no page could be paged out.
+int
+swapout(void)
+{
+  struct proc *me = myproc(), *p;
+  pte_t *pte;
+  uint64 pa;
+  int i, n, s, locked;
+
+  if(swap.nslot == 0 || (s = slotalloc()) < 0)
+    return -1;
+  n = nproc;
+  for(i = 0; i < n; i++){
+    acquire(&swap.lock);
+    p = procs[swap.hand % n];
+    swap.hand = (swap.hand + 1) % n;
+    release(&swap.lock);
+
+    // only this process ever sets p->vmholder to me.
+    locked = 0;
+    if(p->vmholder != me){
+      if(!vmtrylock(p))
+        continue;
+      locked = 1;
+    }
+    pte = 0;
+    acquire(&p->lock);
+    // a running process's TLB could still map the page.
+    if(p == me || p->state == SLEEPING || p->state == RUNNABLE)
+      pte = pick(p);
+    release(&p->lock);
+    if(pte){
+      pa = PTE2PA(*pte);
+      swaprw(s, (char*)pa, 1);
+      *pte = SLOT2PTE(s) | PTE_S | (PTE_FLAGS(*pte) & (PTE_R|PTE_W|PTE_X|PTE_U));
+      kfree((void*)pa);
+      __sync_fetch_and_add(&swap.nout, 1);
+    }
+    if(locked)
+      vmunlock(p);
+    if(pte)
+      return 0;
+  }
+  slotfree(s);
+  return -1;
+}
+
+// Allocate a page for user memory, paging
+// something out if need be. Returns 0 if
+// memory and swap are both full.
+void*
+swapalloc(void)
+{
+  void *mem;
+
+  while((mem = kalloc()) == 0)
+    if(swapout() < 0)
+      return 0;
+  return mem;
+}
+
+// Read p's page at va back from swap.
+// Returns 0, or -1 if the page isn't in swap.
+// Caller must hold p's vm lock.
+static int
+pagein(struct proc *p, uint64 va)
+{
+  pte_t *pte;
+  char *mem;
+  int s;
+
+  if((pte = walk(p->pagetable, va, 0)) == 0 || (*pte & PTE_S) == 0)
+    return -1;
+  if((mem = swapalloc()) == 0)
+    return -1;
+  s = PTE2SLOT(*pte);
+  swaprw(s, mem, 0);
+  *pte = PA2PTE(mem) | (PTE_FLAGS(*pte) & ~PTE_S) | PTE_V | PTE_A;
+  slotfree(s);
+  asidflush(p);
+  __sync_fetch_and_add(&swap.nin, 1);
+  return 0;
+}
+
+// Bring in the page at va of the current process, whose
+// page table is pagetable, after a page fault.
+// Returns 0, or -1 if it wasn't in swap.
+int
+swapin(pagetable_t pagetable, uint64 va)
+{
+  struct proc *p = myproc();
+  int r;
+
+  if(p == 0 || pagetable != p->pagetable || va >= p->sz)
+    return -1;
+  vmlock(p);
+  r = pagein(p, PGROUNDDOWN(va));
+  vmunlock(p);
+  return r;
+}
+
+// Make sure [va, va+n) of the current process is in memory,
+// and keep it there until swapunpin(). For code that copies
+// to or from user memory while holding a spinlock, when a
+// page fault can't sleep to read the page back.
+void
+swappin(uint64 va, uint64 n)
+{
+  struct proc *p = myproc();
+  uint64 a;
+
+  if(swap.nslot == 0)
+    return;
+  vmlock(p);
+  p->pinva = PGROUNDDOWN(va);
+  p->pinend = va + n;
+  for(a = p->pinva; a < p->pinend && a < p->sz; a += PGSIZE)
+    pagein(p, a);
+  vmunlock(p);
+}
+
+void
+swapunpin(void)
+{
+  struct proc *p = myproc();
+
+  if(swap.nslot == 0)
+    return;
+  vmlock(p);
+  p->pinva = p->pinend = 0;
+  vmunlock(p);
+}
+
+// The page-out daemon, a kernel thread: keep some memory
+// free, so that allocations seldom have to wait for swap.
+void
+swapd(void)
+{
+  struct memstat st;
+
+  for(;;){
+    kmemstat(&st);
+    if(swap.nslot > 0 && st.nfree < SWAPLOW){
+      do {
+        if(swapout() < 0)
+          break;
+        kmemstat(&st);
+      } while(st.nfree < SWAPHIGH);
+    }
+    acquire(&tickslock);
+    sleep(&ticks, &tickslock);
+    release(&tickslock);
+  }
+}
+
+// Fill in st's swap counts.
+void
+swapstat(struct memstat *st)
+{
+  st->nswap = swap.nslot;
+  st->swapused = swap.nused;
+  st->pageout = swap.nout;
+  st->pagein = swap.nin;
+}
@@ -6,6 +6,7 @@
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
+#include "stat.h"
 
 // Fetch the uint64 at addr from the current process.
 int
@@ -104,6 +105,17 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_wait(void);
 extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
+extern uint64 sys_ringsetup(void);
+extern uint64 sys_ringenter(void);
+extern uint64 sys_dcachestat(void);
+extern uint64 sys_lockstat(void);
+extern uint64 sys_mount(void);
+extern uint64 sys_prof(void);
+extern uint64 sys_syscallstat(void);
+extern uint64 sys_slabstat(void);
+extern uint64 sys_memstat(void);
+extern uint64 sys_spawn(void);
+extern uint64 sys_waitpid(void);
 
 static uint64 (*syscalls[])(void) = {
 [SYS_fork]    sys_fork,
@@ -127,8 +139,62 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_ringsetup] sys_ringsetup,
+[SYS_ringenter] sys_ringenter,
+[SYS_dcachestat] sys_dcachestat,
+[SYS_lockstat] sys_lockstat,
+[SYS_mount]   sys_mount,
+[SYS_prof]    sys_prof,
+[SYS_syscallstat] sys_syscallstat,
+[SYS_slabstat] sys_slabstat,
+[SYS_memstat] sys_memstat,
+[SYS_spawn]   sys_spawn,
+[SYS_waitpid] sys_waitpid,
 };
 
+// names for syscallstat().
+static char *syscallnames[] = {
+[SYS_fork]    "fork",
+[SYS_exit]    "exit",
+[SYS_wait]    "wait",
+[SYS_pipe]    "pipe",
+[SYS_read]    "read",
+[SYS_kill]    "kill",
+[SYS_exec]    "exec",
+[SYS_fstat]   "fstat",
+[SYS_chdir]   "chdir",
+[SYS_dup]     "dup",
+[SYS_getpid]  "getpid",
+[SYS_sbrk]    "sbrk",
+[SYS_sleep]   "sleep",
+[SYS_uptime]  "uptime",
+[SYS_open]    "open",
+[SYS_write]   "write",
+[SYS_mknod]   "mknod",
+[SYS_unlink]  "unlink",
+[SYS_link]    "link",
+[SYS_mkdir]   "mkdir",
+[SYS_close]   "close",
+[SYS_ringsetup] "ringsetup",
+[SYS_ringenter] "ringenter",
+[SYS_dcachestat] "dcachestat",
+[SYS_lockstat] "lockstat",
+[SYS_mount]   "mount",
+[SYS_prof]    "prof",
+[SYS_syscallstat] "syscallstat",
+[SYS_slabstat] "slabstat",
+[SYS_memstat] "memstat",
+[SYS_spawn]   "spawn",
+[SYS_waitpid] "waitpid",
+};
+
+// system-wide counters for each system call.
+static struct {
+  uint64 count;
+  uint64 time;
+  uint64 hist[NSCHIST];
+} scstat[NELEM(syscalls)];
+
 void
 syscall(void)
 {
@@ -137,10 +203,54 @@ syscall(void)
 
   num = p->trapframe->a7;
   if(num > 0 && num < NELEM(syscalls) && syscalls[num]) {
+    uint64 t0 = r_time(), t;
+    int b;
+
+    __sync_fetch_and_add(&scstat[num].count, 1);
+    p->sccount[num]++;
+
     p->trapframe->a0 = syscalls[num]();
+
+    t = r_time() - t0;
+    for(b = 0; b < NSCHIST-1 && (t >> (b+1)) != 0; b++)
+      ;
+    __sync_fetch_and_add(&scstat[num].time, t);
+    __sync_fetch_and_add(&scstat[num].hist[b], 1);
+    p->sctime[num] += t;
   } else {
     printf("%d %s: unknown sys call %d\n",
             p->pid, p->name, num);
     p->trapframe->a0 = -1;
   }
 }
+
+// syscallstat(num, pid, st): copy the counters for system
+// call num to the user struct syscallstat at st: for the
+// whole system if pid is 0, else for process pid (without
+// a histogram). Returns -1 if there's no such system call
+// or process.
+uint64
+sys_syscallstat(void)
+{
+  struct syscallstat st;
+  uint64 addr;
+  int num, pid;
+
+  if(argint(0, &num) < 0 || argint(1, &pid) < 0 || argaddr(2, &addr) < 0)
+    return -1;
+  if(num <= 0 || num >= NELEM(syscalls) || syscalls[num] == 0)
+    return -1;
+
+  memset(&st, 0, sizeof(st));
+  safestrcpy(st.name, syscallnames[num], sizeof(st.name));
+  if(pid == 0){
+    st.count = scstat[num].count;
+    st.time = scstat[num].time;
+    memmove(st.hist, scstat[num].hist, sizeof(st.hist));
+  } else if(procsyscallstat(pid, num, &st.count, &st.time) < 0){
+    return -1;
+  }
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
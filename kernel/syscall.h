@@ -20,3 +20,14 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_ringsetup 22
+#define SYS_ringenter 23
+#define SYS_dcachestat 24
+#define SYS_lockstat 25
+#define SYS_mount  26
+#define SYS_prof   27
+#define SYS_syscallstat 28
+#define SYS_slabstat 29
+#define SYS_memstat 30
+#define SYS_spawn  31
+#define SYS_waitpid 32
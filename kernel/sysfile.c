@@ -15,6 +15,20 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "ring.h"
+
+// Look up the struct file for file descriptor fd.
+static int
+getfd(int fd, struct file **pf)
+{
+  struct file *f;
+
+  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+    return -1;
+  if(pf)
+    *pf = f;
+  return 0;
+}
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -22,16 +36,13 @@ static int
 argfd(int n, int *pfd, struct file **pf)
 {
   int fd;
-  struct file *f;
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if(getfd(fd, pf) < 0)
     return -1;
   if(pfd)
     *pfd = fd;
-  if(pf)
-    *pf = f;
   return 0;
 }
 
@@ -91,19 +102,28 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
-uint64
-sys_close(void)
+static int
+closefd(int fd)
 {
-  int fd;
   struct file *f;
 
-  if(argfd(0, &fd, &f) < 0)
+  if(getfd(fd, &f) < 0)
     return -1;
   myproc()->ofile[fd] = 0;
   fileclose(f);
   return 0;
 }
 
+uint64
+sys_close(void)
+{
+  int fd;
+
+  if(argint(0, &fd) < 0)
+    return -1;
+  return closefd(fd);
+}
+
 uint64
 sys_fstat(void)
 {
@@ -165,27 +185,10 @@ bad:
   return -1;
 }
 
-// Is the directory dp empty except for "." and ".." ?
-static int
-isdirempty(struct inode *dp)
-{
-  int off;
-  struct dirent de;
-
-  for(off=2*sizeof(de); off<dp->size; off+=sizeof(de)){
-    if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-      panic("isdirempty: readi");
-    if(de.inum != 0)
-      return 0;
-  }
-  return 1;
-}
-
 uint64
 sys_unlink(void)
 {
   struct inode *ip, *dp;
-  struct dirent de;
   char name[DIRSIZ], path[MAXPATH];
   uint off;
 
@@ -210,14 +213,12 @@ sys_unlink(void)
 
   if(ip->nlink < 1)
     panic("unlink: nlink < 1");
-  if(ip->type == T_DIR && !isdirempty(ip)){
+  if(ip->type == T_DIR && (!dirempty(ip) || mounted(ip))){
     iunlockput(ip);
     goto bad;
   }
 
-  memset(&de, 0, sizeof(de));
-  if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-    panic("unlink: writei");
+  dirunlink(dp, name, off);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -258,8 +259,10 @@ create(char *path, short type, short major, short minor)
     return 0;
   }
 
-  if((ip = ialloc(dp->dev, type)) == 0)
-    panic("create: ialloc");
+  if((ip = ialloc(dp->dev, type)) == 0){
+    iunlockput(dp);
+    return 0;
+  }
 
   ilock(ip);
   ip->major = major;
@@ -268,32 +271,39 @@ create(char *path, short type, short major, short minor)
   iupdate(ip);
 
   if(type == T_DIR){  // Create . and .. entries.
-    dp->nlink++;  // for ".."
-    iupdate(dp);
     // No ip->nlink++ for ".": avoid cyclic ref count.
-    if(dirlink(ip, ".", ip->inum) < 0 || dirlink(ip, "..", dp->inum) < 0)
-      panic("create dots");
+    if(dirinit(ip, dp->inum) < 0)
+      goto fail;
   }
 
   if(dirlink(dp, name, ip->inum) < 0)
-    panic("create: dirlink");
+    goto fail;
+
+  if(type == T_DIR){
+    // now that success is guaranteed:
+    dp->nlink++;  // for ".."
+    iupdate(dp);
+  }
 
   iunlockput(dp);
 
   return ip;
+
+ fail:
+  // something went wrong (a full directory). de-allocate ip.
+  ip->nlink = 0;
+  iupdate(ip);
+  iunlockput(ip);
+  iunlockput(dp);
+  return 0;
 }
 
-uint64
-sys_open(void)
+static int
+openpath(char *path, int omode)
 {
-  char path[MAXPATH];
-  int fd, omode;
+  int fd;
   struct file *f;
   struct inode *ip;
-  int n;
-
-  if((n = argstr(0, path, MAXPATH)) < 0 || argint(1, &omode) < 0)
-    return -1;
 
   begin_op();
 
@@ -351,6 +361,17 @@ sys_open(void)
   return fd;
 }
 
+uint64
+sys_open(void)
+{
+  char path[MAXPATH];
+  int omode;
+
+  if(argstr(0, path, MAXPATH) < 0 || argint(1, &omode) < 0)
+    return -1;
+  return openpath(path, omode);
+}
+
 uint64
 sys_mkdir(void)
 {
@@ -387,6 +408,40 @@ sys_mknod(void)
   return 0;
 }
 
+// mount(type, path): mount a new file system of
+// the given type (only "tmpfs") on directory path.
+uint64
+sys_mount(void)
+{
+  char type[16], path[MAXPATH];
+  struct inode *ip;
+
+  if(argstr(0, type, sizeof(type)) < 0 || argstr(1, path, MAXPATH) < 0)
+    return -1;
+  if(strncmp(type, "tmpfs", sizeof(type)) != 0)
+    return -1;
+
+  begin_op();
+  if((ip = namei(path)) == 0){
+    end_op();
+    return -1;
+  }
+  ilock(ip);
+  if(ip->type != T_DIR){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+  iunlock(ip);
+  if(mount(ip) < 0){
+    iput(ip);
+    end_op();
+    return -1;
+  }
+  end_op();
+  return 0;
+}
+
 uint64
 sys_chdir(void)
 {
@@ -412,19 +467,29 @@ sys_chdir(void)
   return 0;
 }
 
-uint64
-sys_exec(void)
+static void
+argvfree(char **argv)
+{
+  int i;
+
+  for(i = 0; i < MAXARG && argv[i] != 0; i++)
+    kfree(argv[i]);
+}
+
+// Fetch the nth system call argument as a user argv[],
+// copying the strings into pages from kalloc() for
+// argvfree(). Returns 0, or -1 on error.
+static int
+argargv(int n, char **argv)
 {
-  char path[MAXPATH], *argv[MAXARG];
   int i;
   uint64 uargv, uarg;
 
-  if(argstr(0, path, MAXPATH) < 0 || argaddr(1, &uargv) < 0){
+  memset(argv, 0, MAXARG*sizeof(char*));
+  if(argaddr(n, &uargv) < 0)
     return -1;
-  }
-  memset(argv, 0, sizeof(argv));
   for(i=0;; i++){
-    if(i >= NELEM(argv)){
+    if(i >= MAXARG){
       goto bad;
     }
     if(fetchaddr(uargv+sizeof(uint64)*i, (uint64*)&uarg) < 0){
@@ -440,18 +505,75 @@ sys_exec(void)
     if(fetchstr(uarg, argv[i], PGSIZE) < 0)
       goto bad;
   }
+  return 0;
 
-  int ret = exec(path, argv);
+ bad:
+  argvfree(argv);
+  return -1;
+}
 
-  for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
-    kfree(argv[i]);
+uint64
+sys_exec(void)
+{
+  char path[MAXPATH], *argv[MAXARG];
+  int ret;
+
+  if(argstr(0, path, MAXPATH) < 0 || argargv(1, argv) < 0){
+    return -1;
+  }
+  ret = exec(path, argv);
+  argvfree(argv);
+  return ret;
+}
+
+// spawn(path, argv, fds, nfd): start path in a new process.
+// The child's descriptor i is a dup of the caller's fds[i],
+// or closed if fds[i] is -1, for i < nfd, and the child has
+// no others. If fds is 0 the child gets all the caller's.
+uint64
+sys_spawn(void)
+{
+  char path[MAXPATH], *argv[MAXARG];
+  struct file *ofile[NOFILE];
+  uint64 ufds;
+  int i, fd, nfd, ret;
+  struct proc *p = myproc();
 
+  if(argstr(0, path, MAXPATH) < 0 || argaddr(2, &ufds) < 0 ||
+     argint(3, &nfd) < 0)
+    return -1;
+  if(ufds == 0){
+    memmove(ofile, p->ofile, sizeof(ofile));
+  } else {
+    if(nfd < 0 || nfd > NOFILE)
+      return -1;
+    memset(ofile, 0, sizeof(ofile));
+    for(i = 0; i < nfd; i++){
+      if(copyin(p->pagetable, (char*)&fd, ufds + i*sizeof(fd), sizeof(fd)) < 0)
+        return -1;
+      if(fd != -1 && getfd(fd, &ofile[i]) < 0)
+        return -1;
+    }
+  }
+  if(argargv(1, argv) < 0)
+    return -1;
+  ret = spawn(path, argv, ofile);
+  argvfree(argv);
   return ret;
+}
 
- bad:
-  for(i = 0; i < NELEM(argv) && argv[i] != 0; i++)
-    kfree(argv[i]);
-  return -1;
+uint64
+sys_dcachestat(void)
+{
+  uint64 addr; // user pointer to struct dcachestat
+  struct dcachestat st;
+
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  dcachestat(&st);
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
 }
 
 uint64
@@ -484,3 +606,30 @@ sys_pipe(void)
   }
   return 0;
 }
+
+// Run one operation from the system call ring (see ring.c).
+// Returns what the equivalent system call would have.
+int
+ringop(struct ringsqe *e)
+{
+  struct file *f;
+  char path[MAXPATH];
+
+  switch(e->op){
+  case RING_READ:
+    if(getfd(e->fd, &f) < 0)
+      return -1;
+    return fileread(f, e->addr, e->n);
+  case RING_WRITE:
+    if(getfd(e->fd, &f) < 0)
+      return -1;
+    return filewrite(f, e->addr, e->n);
+  case RING_OPEN:
+    if(fetchstr(e->addr, path, MAXPATH) < 0)
+      return -1;
+    return openpath(path, e->n);
+  case RING_CLOSE:
+    return closefd(e->fd);
+  }
+  return -1;
+}
@@ -6,6 +6,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "stat.h"
 
 uint64
 sys_exit(void)
@@ -33,9 +34,29 @@ uint64
 sys_wait(void)
 {
   uint64 p;
+  int pid;
+
   if(argaddr(0, &p) < 0)
     return -1;
-  return wait(p);
+  // wait() copies out the status holding locks.
+  swappin(p, sizeof(int));
+  pid = wait(p);
+  swapunpin();
+  return pid;
+}
+
+uint64
+sys_waitpid(void)
+{
+  uint64 p;
+  int pid, options;
+
+  if(argint(0, &pid) < 0 || argaddr(1, &p) < 0 || argint(2, &options) < 0)
+    return -1;
+  swappin(p, sizeof(int));
+  pid = waitpid(pid, p, options);
+  swapunpin();
+  return pid;
 }
 
 uint64
@@ -95,3 +116,56 @@ sys_uptime(void)
   release(&tickslock);
   return xticks;
 }
+
+// copy up to n sets of spinlock counters to the
+// user array of struct lockstat. returns how many.
+uint64
+sys_lockstat(void)
+{
+  uint64 addr;
+  struct lockstat st;
+  int n, i;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  for(i = 0; i < n && lockstat(i, &st) == 0; i++){
+    if(copyout(myproc()->pagetable, addr + i*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+  }
+  return i;
+}
+
+// copy the statistics for up to n kernel object caches to a
+// user array of struct slabstat. returns how many.
+uint64
+sys_slabstat(void)
+{
+  uint64 addr;
+  struct slabstat st;
+  int n, i;
+
+  if(argaddr(0, &addr) < 0 || argint(1, &n) < 0)
+    return -1;
+  for(i = 0; i < n && slabstat(i, &st) == 0; i++){
+    if(copyout(myproc()->pagetable, addr + i*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+  }
+  return i;
+}
+
+// copy the free physical memory and swap
+// counts to a user struct memstat.
+uint64
+sys_memstat(void)
+{
+  uint64 addr;
+  struct memstat st;
+
+  if(argaddr(0, &addr) < 0)
+    return -1;
+  kmemstat(&st);
+  swapstat(&st);
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
@@ -0,0 +1,195 @@
+//
+// In-memory file system.
+//
+// A tmpfs keeps file and directory content in pages from
+// kalloc() and its inodes only in the inode table, so
+// nothing is logged or written to disk, and everything is
+// gone at reboot. Each tmpfs has its own device number;
+// fs.c's inode functions call here for inodes on one
+// (see istmp()), and mount() in fs.c attaches a tmpfs to
+// a directory.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// a file's pages are listed in one page of pointers.
+#define NTMPPAGE (PGSIZE / sizeof(char*))
+
+// inode numbers must fit in a dirent's ushort inum.
+#define NTMPINUM 65536
+
+struct {
+  struct spinlock lock;
+  int used[NMOUNT];
+  uchar inums[NMOUNT][NTMPINUM/8];  // bitmap of inums in use
+  uint next[NMOUNT];                // where to start looking
+  int ninode;                       // live inodes, all tmpfs
+} tmpfs;
+
+void
+tmpfsinit(void)
+{
+  initlock(&tmpfs.lock, "tmpfs");
+}
+
+// Is dev a tmpfs?
+int
+istmp(uint dev)
+{
+  return dev >= TMPDEV && dev < TMPDEV + NMOUNT;
+}
+
+// Make a new, empty tmpfs.
+// Returns its device number, or -1 if there are too many.
+int
+tmpfsalloc(void)
+{
+  int i;
+
+  acquire(&tmpfs.lock);
+  for(i = 0; i < NMOUNT; i++){
+    if(!tmpfs.used[i]){
+      tmpfs.used[i] = 1;
+      memset(tmpfs.inums[i], 0, sizeof(tmpfs.inums[i]));
+      tmpfs.inums[i][0] = 1;  // inum 0 means an empty dirent
+      tmpfs.next[i] = ROOTINO;
+      release(&tmpfs.lock);
+      return TMPDEV + i;
+    }
+  }
+  release(&tmpfs.lock);
+  return -1;
+}
+
+// Give back tmpfs dev, which must have no inodes.
+void
+tmpfsfree(uint dev)
+{
+  acquire(&tmpfs.lock);
+  tmpfs.used[dev - TMPDEV] = 0;
+  release(&tmpfs.lock);
+}
+
+// Pick an unused inode number on tmpfs dev.
+// The first is ROOTINO, for the root directory.
+// Tmpfs inodes can't be evicted from the inode table,
+// so returns 0 if all tmpfs together already have max
+// inodes, or if dev has run out of numbers.
+uint
+tmpinum(uint dev, int max)
+{
+  uchar *map = tmpfs.inums[dev - TMPDEV];
+  uint i, inum;
+
+  acquire(&tmpfs.lock);
+  if(tmpfs.ninode >= max){
+    release(&tmpfs.lock);
+    return 0;
+  }
+  inum = tmpfs.next[dev - TMPDEV];
+  for(i = 0; i < NTMPINUM; i++, inum++){
+    inum %= NTMPINUM;
+    if((map[inum/8] & (1 << (inum%8))) == 0){
+      map[inum/8] |= 1 << (inum%8);
+      tmpfs.next[dev - TMPDEV] = inum + 1;
+      tmpfs.ninode++;
+      release(&tmpfs.lock);
+      return inum;
+    }
+  }
+  release(&tmpfs.lock);
+  return 0;
+}
+
+// Give back inode number inum on tmpfs dev,
+// once iput() has freed the inode.
+void
+tmpifree(uint dev, uint inum)
+{
+  uchar *map = tmpfs.inums[dev - TMPDEV];
+
+  acquire(&tmpfs.lock);
+  if((map[inum/8] & (1 << (inum%8))) == 0)
+    panic("tmpifree");
+  map[inum/8] &= ~(1 << (inum%8));
+  tmpfs.ninode--;
+  release(&tmpfs.lock);
+}
+
+// Read data from a tmpfs inode, like readi().
+int
+tmpread(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
+{
+  uint tot, m;
+
+  if(off > ip->size || off + n < off)
+    return 0;
+  if(off + n > ip->size)
+    n = ip->size - off;
+
+  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
+    m = min(n - tot, PGSIZE - off%PGSIZE);
+    if(either_copyout(user_dst, dst, ip->pages[off/PGSIZE] + off%PGSIZE, m) == -1)
+      return -1;
+  }
+  return tot;
+}
+
+// Write data to a tmpfs inode, like writei(),
+// allocating pages as the file grows.
+int
+tmpwrite(struct inode *ip, int user_src, uint64 src, uint off, uint n)
+{
+  uint tot, m;
+  char **pp;
+
+  if(off > ip->size || off + n < off)
+    return -1;
+  if(off + n > NTMPPAGE*PGSIZE)
+    return -1;
+
+  if(ip->pages == 0){
+    if((ip->pages = (char**)kalloc()) == 0)
+      return -1;
+    pgzero(ip->pages);
+  }
+
+  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
+    pp = &ip->pages[off/PGSIZE];
+    if(*pp == 0 && (*pp = kalloc()) == 0)
+      break;
+    m = min(n - tot, PGSIZE - off%PGSIZE);
+    if(either_copyin(*pp + off%PGSIZE, user_src, src, m) == -1)
+      break;
+  }
+
+  if(off > ip->size)
+    ip->size = off;
+  return tot;
+}
+
+// Free a tmpfs inode's content.
+void
+tmptrunc(struct inode *ip)
+{
+  int i;
+
+  if(ip->pages){
+    for(i = 0; i < NTMPPAGE; i++)
+      if(ip->pages[i])
+        kfree(ip->pages[i]);
+    kfree((char*)ip->pages);
+    ip->pages = 0;
+  }
+  ip->size = 0;
+}
@@ -11,6 +11,9 @@ uint ticks;
 
 extern char trampoline[], uservec[], userret[];
 
+// in copyuser.S.
+extern char copyfault[], copyuserend[];
+
 // in kernelvec.S, calls kerneltrap().
 void kernelvec();
 
@@ -67,6 +70,16 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
+  } else if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15){
+    // page fault: perhaps on a page that's in swap.
+    uint64 scause = r_scause();
+    uint64 va = r_stval();
+    intr_on();
+    if(swapin(p->pagetable, va) < 0){
+      printf("usertrap(): unexpected scause %p pid=%d\n", scause, p->pid);
+      printf("            sepc=%p stval=%p\n", p->trapframe->epc, va);
+      p->killed = 1;
+    }
   } else {
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
@@ -119,7 +132,7 @@ usertrapret(void)
   w_sepc(p->trapframe->epc);
 
   // tell trampoline.S the user page table to switch to.
-  uint64 satp = MAKE_SATP(p->pagetable);
+  uint64 satp = MAKE_SATP(p->pagetable) | SATP_ASID(p->uasid);
 
   // jump to trampoline.S at the top of memory, which 
   // switches to the user page table, restores user registers,
@@ -143,7 +156,12 @@ kerneltrap()
   if(intr_get() != 0)
     panic("kerneltrap: interrupts enabled");
 
-  if((which_dev = devintr()) == 0){
+  if((scause == 13 || scause == 15) &&
+     sepc >= (uint64)copyuser && sepc < (uint64)copyuserend){
+    // a page fault in copyuser() or copyuserstr(), on a
+    // bad user address: make it return -1.
+    sepc = (uint64)copyfault;
+  } else if((which_dev = devintr()) == 0){
     printf("scause %p\n", scause);
     printf("sepc=%p stval=%p\n", r_sepc(), r_stval());
     panic("kerneltrap");
@@ -204,7 +222,11 @@ devintr()
     // software interrupt from a machine-mode timer interrupt,
     // forwarded by timervec in kernelvec.S.
 
-    if(cpuid() == 0){
+    // while profiling, only some timer interrupts are
+    // clock ticks; the rest just take a sample.
+    int tick = proftick();
+
+    if(tick && cpuid() == 0){
       clockintr();
     }
     
@@ -212,7 +234,7 @@ devintr()
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    return tick ? 2 : 1;
   } else {
     return 0;
   }
@@ -33,14 +33,16 @@
 #define LCR_BAUD_LATCH (1<<7) // special mode to set baud rate
 #define LSR 5                 // line status register
 #define LSR_RX_READY (1<<0)   // input is waiting to be read from RHR
-#define LSR_TX_IDLE (1<<5)    // THR can accept another character to send
+#define LSR_TX_IDLE (1<<5)    // THR and the transmit FIFO are empty
+
+#define UART_FIFO 16          // bytes the transmit FIFO holds
 
 #define ReadReg(reg) (*(Reg(reg)))
 #define WriteReg(reg, v) (*(Reg(reg)) = (v))
 
 // the transmit output buffer.
 struct spinlock uart_tx_lock;
-#define UART_TX_BUF_SIZE 32
+#define UART_TX_BUF_SIZE (4*PGSIZE)
 char uart_tx_buf[UART_TX_BUF_SIZE];
 uint64 uart_tx_w; // write next to uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE]
 uint64 uart_tx_r; // read next from uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]
@@ -108,6 +110,47 @@ uartputc(int c)
   }
 }
 
+// copy n bytes from src (a user address if user_src)
+// into the output buffer, sleeping whenever it is full,
+// and start sending them. returns the number of bytes
+// copied, which is less than n only if a copy failed.
+// like uartputc(), only suitable for use by write().
+int
+uartwrite(int user_src, uint64 src, int n)
+{
+  int i, m;
+
+  acquire(&uart_tx_lock);
+
+  if(panicked){
+    for(;;)
+      ;
+  }
+
+  for(i = 0; i < n; i += m){
+    if(uart_tx_w == uart_tx_r + UART_TX_BUF_SIZE){
+      // buffer is full.
+      uartstart();
+      sleep(&uart_tx_r, &uart_tx_lock);
+      m = 0;
+      continue;
+    }
+    // copy as much as fits before the free space
+    // wraps around to the start of the buffer.
+    m = UART_TX_BUF_SIZE - (uart_tx_w - uart_tx_r);
+    if(m > UART_TX_BUF_SIZE - uart_tx_w % UART_TX_BUF_SIZE)
+      m = UART_TX_BUF_SIZE - uart_tx_w % UART_TX_BUF_SIZE;
+    if(m > n - i)
+      m = n - i;
+    if(either_copyin(&uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE], user_src, src + i, m) == -1)
+      break;
+    uart_tx_w += m;
+  }
+  uartstart();
+  release(&uart_tx_lock);
+  return i;
+}
+
 // alternate version of uartputc() that doesn't 
 // use interrupts, for use by kernel printf() and
 // to echo characters. it spins waiting for the uart's
@@ -130,34 +173,34 @@ uartputc_sync(int c)
   pop_off();
 }
 
-// if the UART is idle, and a character is waiting
-// in the transmit buffer, send it.
+// if the UART is idle, and characters are waiting
+// in the transmit buffer, fill its FIFO with them.
 // caller must hold uart_tx_lock.
 // called from both the top- and bottom-half.
 void
 uartstart()
 {
-  while(1){
-    if(uart_tx_w == uart_tx_r){
-      // transmit buffer is empty.
-      return;
-    }
-    
-    if((ReadReg(LSR) & LSR_TX_IDLE) == 0){
-      // the UART transmit holding register is full,
-      // so we cannot give it another byte.
-      // it will interrupt when it's ready for a new byte.
-      return;
-    }
-    
-    int c = uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE];
+  int i;
+
+  if(uart_tx_w == uart_tx_r){
+    // transmit buffer is empty.
+    return;
+  }
+
+  if((ReadReg(LSR) & LSR_TX_IDLE) == 0){
+    // the UART transmit FIFO still has bytes to send.
+    // it will interrupt when it has sent them all.
+    return;
+  }
+
+  // the FIFO is empty, so it has room for UART_FIFO bytes.
+  for(i = 0; i < UART_FIFO && uart_tx_r != uart_tx_w; i++){
+    WriteReg(THR, uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]);
     uart_tx_r += 1;
-    
-    // maybe uartputc() is waiting for space in the buffer.
-    wakeup(&uart_tx_r);
-    
-    WriteReg(THR, c);
   }
+
+  // maybe uartputc() or uartwrite() is waiting for space in the buffer.
+  wakeup(&uart_tx_r);
 }
 
 // read one input character from the UART.
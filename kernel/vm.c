@@ -5,6 +5,8 @@
 #include "riscv.h"
 #include "defs.h"
 #include "fs.h"
+#include "spinlock.h"
+#include "proc.h"
 
 /*
  * the kernel's page table.
@@ -15,6 +17,11 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+static int asids;  // does satp hold ASIDs up to MAXASID?
+
+// kallocorder() order of a megapage.
+#define MEGAORDER 9
+
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
@@ -22,29 +29,33 @@ kvmmake(void)
   pagetable_t kpgtbl;
 
   kpgtbl = (pagetable_t) kalloc();
-  memset(kpgtbl, 0, PGSIZE);
+  pgzero(kpgtbl);
+
+  // the devices and RAM are mapped the same way in every
+  // process's kernel page table and not at all in user page
+  // tables, so their TLB entries can be global.
 
   // uart registers
-  kvmmap(kpgtbl, UART0, UART0, PGSIZE, PTE_R | PTE_W);
+  kvmmap(kpgtbl, UART0, UART0, PGSIZE, PTE_R | PTE_W | PTE_G);
 
   // virtio mmio disk interface
-  kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
+  kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W | PTE_G);
 
   // PLIC
-  kvmmap(kpgtbl, PLIC, PLIC, 0x400000, PTE_R | PTE_W);
+  kvmmap(kpgtbl, PLIC, PLIC, 0x400000, PTE_R | PTE_W | PTE_G);
 
   // map kernel text executable and read-only.
-  kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
+  kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X | PTE_G);
 
-  // map kernel data and the physical RAM we'll make use of.
-  kvmmap(kpgtbl, (uint64)etext, (uint64)etext, PHYSTOP-(uint64)etext, PTE_R | PTE_W);
+  // map kernel data and the physical RAM we'll make use of,
+  // with megapages from the first 2MB boundary up.
+  kvmmap(kpgtbl, (uint64)etext, (uint64)etext, physend-(uint64)etext, PTE_R | PTE_W | PTE_G);
 
   // map the trampoline for trap entry/exit to
   // the highest virtual address in the kernel.
   kvmmap(kpgtbl, TRAMPOLINE, (uint64)trampoline, PGSIZE, PTE_R | PTE_X);
 
-  // map kernel stacks
-  proc_mapstacks(kpgtbl);
+  // kernel stacks are mapped as processes are made; see newproc().
   
   return kpgtbl;
 }
@@ -56,18 +67,101 @@ kvminit(void)
   kernel_pagetable = kvmmake();
 }
 
+// Each process has its own kernel page table, which the CPU
+// uses while it runs that process in the kernel. It shares every
+// mapping in kernel_pagetable, and also maps the process's user
+// memory, so that copyout() and copyin() can use user addresses
+// directly. Both user memory and the devices below KERNBASE fall
+// under the first top-level entry; user memory is kept below
+// MAXUSER (PLIC), so it has first-level entries of its own, which
+// kvmsync() copies from the user page table.
+
+// First-level entries that user memory can occupy.
+#define NUSERL1 PX(1, MAXUSER)
+
+// Make a kernel page table for a process, with no user memory yet.
+pagetable_t
+kvmcreate(void)
+{
+  pagetable_t kpt, l1;
+
+  if((kpt = (pagetable_t)kalloc()) == 0)
+    return 0;
+  if((l1 = (pagetable_t)kalloc()) == 0){
+    kfree(kpt);
+    return 0;
+  }
+  pgcopy(kpt, kernel_pagetable);
+  pgcopy(l1, (pagetable_t)PTE2PA(kernel_pagetable[0]));
+  kpt[0] = PA2PTE(l1) | PTE_V;
+  return kpt;
+}
+
+// Copy the user memory mappings of pagetable into the process
+// kernel page table kpt. Must be called whenever pagetable may
+// have gained first-level entries, i.e. after it grows, and
+// whenever a megapage may have been mapped or unmapped, since
+// its first-level entry is copied rather than shared. The
+// caller must flush the TLB, with asidflush().
+void
+kvmsync(pagetable_t kpt, pagetable_t pagetable)
+{
+  pagetable_t kl1, l1;
+  int i;
+
+  kl1 = (pagetable_t)PTE2PA(kpt[0]);
+  l1 = 0;
+  if(pagetable[0] & PTE_V)
+    l1 = (pagetable_t)PTE2PA(pagetable[0]);
+  for(i = 0; i < NUSERL1; i++)
+    kl1[i] = l1 ? l1[i] : 0;
+}
+
+// Free a process kernel page table. The lower-level pages
+// belong to kernel_pagetable and the user page table.
+void
+kvmfree(pagetable_t kpt)
+{
+  kfree((void*)PTE2PA(kpt[0]));
+  kfree(kpt);
+}
+
 // Switch h/w page table register to the kernel's page table,
 // and enable paging.
 void
 kvminithart()
 {
+  // the ASID field ignores writes to bits that the
+  // hardware doesn't implement.
+  w_satp(MAKE_SATP(kernel_pagetable) | SATP_ASID(MAXASID));
+  asids = SATP2ASID(r_satp()) == MAXASID;
   w_satp(MAKE_SATP(kernel_pagetable));
   sfence_vma();
 }
 
+// Are there enough ASIDs to give each process its own?
+int
+kvmasids(void)
+{
+  return asids;
+}
+
+// Switch from a process's kernel page table back to
+// kernel_pagetable. It doesn't change after boot, so its
+// TLB entries (ASID 0) are never stale, but without ASIDs
+// the TLB still holds the process's.
+void
+kvmswitch(void)
+{
+  w_satp(MAKE_SATP(kernel_pagetable));
+  if(!asids)
+    sfence_vma();
+}
+
 // Return the address of the PTE in page table pagetable
 // that corresponds to virtual address va.  If alloc!=0,
-// create any required page-table pages.
+// create any required page-table pages. If va is in a
+// megapage, returns its level-1 PTE, which has PTE_MEGA set.
 //
 // The risc-v Sv39 scheme has three levels of page-table
 // pages. A page-table page contains 512 64-bit PTEs.
@@ -85,12 +179,14 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
 
   for(int level = 2; level > 0; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
+    if(*pte & PTE_MEGA)
+      return pte;
     if(*pte & PTE_V) {
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
       if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
+      pgzero(pagetable);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -117,17 +213,134 @@ walkaddr(pagetable_t pagetable, uint64 va)
   if((*pte & PTE_U) == 0)
     return 0;
   pa = PTE2PA(*pte);
+  if(*pte & PTE_MEGA)
+    pa += PGROUNDDOWN(va) % MEGAPGSIZE;
   return pa;
 }
 
-// add a mapping to the kernel page table.
+// Return the address of the level-1 PTE for va, creating
+// the level-1 page-table page if alloc!=0 and it's missing.
+static pte_t *
+walkl1(pagetable_t pagetable, uint64 va, int alloc)
+{
+  pte_t *pte = &pagetable[PX(2, va)];
+  pagetable_t l1;
+
+  if(*pte & PTE_V){
+    l1 = (pagetable_t)PTE2PA(*pte);
+  } else {
+    if(!alloc || (l1 = (pagetable_t)kalloc()) == 0)
+      return 0;
+    pgzero(l1);
+    *pte = PA2PTE(l1) | PTE_V;
+  }
+  return &l1[PX(1, va)];
+}
+
+// Map the megapage at va to physical address pa, both
+// aligned to MEGAPGSIZE, with a level-1 leaf PTE.
+// Returns 0, or -1 if walkl1() couldn't allocate a
+// needed page-table page.
+static int
+mapmega(pagetable_t pagetable, uint64 va, uint64 pa, int perm)
+{
+  pte_t *pte;
+
+  if((pte = walkl1(pagetable, va, 1)) == 0)
+    return -1;
+  if(*pte & PTE_V)
+    panic("mapmega: remap");
+  *pte = PA2PTE(pa) | perm | PTE_MEGA | PTE_V;
+  return 0;
+}
+
+// Can va's level-1 PTE be made a megapage leaf?
+// It can if it's unused, or if it points to a level-0
+// page-table page with nothing left in it, which is freed.
+static int
+megaready(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  pagetable_t l0;
+  int i;
+
+  if((pagetable[PX(2, va)] & PTE_V) == 0)
+    return 1;
+  pte = walkl1(pagetable, va, 0);
+  if((*pte & PTE_V) == 0)
+    return 1;
+  if(*pte & PTE_MEGA)
+    return 0;
+  l0 = (pagetable_t)PTE2PA(*pte);
+  for(i = 0; i < 512; i++)
+    if(l0[i] & PTE_V)
+      return 0;
+  kfree(l0);
+  *pte = 0;
+  return 1;
+}
+
+// Replace the megapage leaf *pte with a level-0 page-table
+// page mapping the same memory with ordinary pages, which
+// can then be unmapped and freed one at a time.
+// Returns 0, or -1 if out of memory.
+static int
+demote(pte_t *pte)
+{
+  pagetable_t l0;
+  uint64 pa, flags;
+  int i;
+
+  if((l0 = (pagetable_t)kalloc()) == 0)
+    return -1;
+  pa = PTE2PA(*pte);
+  flags = PTE_FLAGS(*pte) & ~PTE_MEGA;
+  for(i = 0; i < 512; i++)
+    l0[i] = PA2PTE(pa + i*PGSIZE) | flags;
+  *pte = PA2PTE(l0) | PTE_V;
+  return 0;
+}
+
+// Split the megapage that maps va in pagetable, if there is
+// one, into ordinary pages, so that swapout() can take them
+// one at a time. Returns 0, or -1 if out of memory. The
+// caller must kvmsync() and flush the TLB.
+int
+uvmsplit(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+
+  if((pte = walk(pagetable, va, 0)) == 0 || (*pte & PTE_MEGA) == 0)
+    return 0;
+  return demote(pte);
+}
+
+// add a mapping to the kernel page table, using megapages
+// for whatever part of it is suitably aligned.
 // only used when booting.
 // does not flush TLB or enable paging.
 void
 kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 {
-  if(mappages(kpgtbl, va, sz, pa, perm) != 0)
-    panic("kvmmap");
+  uint64 n;
+
+  while(sz > 0){
+    if(va % MEGAPGSIZE == 0 && pa % MEGAPGSIZE == 0 && sz >= MEGAPGSIZE){
+      n = MEGAPGSIZE;
+      if(mapmega(kpgtbl, va, pa, perm) != 0)
+        panic("kvmmap");
+    } else {
+      // ordinary pages up to the next megapage boundary.
+      n = MEGAPGSIZE - va % MEGAPGSIZE;
+      if(n > sz)
+        n = sz;
+      if(mappages(kpgtbl, va, n, pa, perm) != 0)
+        panic("kvmmap");
+    }
+    va += n;
+    pa += n;
+    sz -= n;
+  }
 }
 
 // Create PTEs for virtual addresses starting at va that refer to
@@ -161,26 +374,41 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
 
 // Remove npages of mappings starting from va. va must be
 // page-aligned. The mappings must exist.
-// Optionally free the physical memory.
+// Optionally free the physical memory, or swap slot.
+// Megapages must lie wholly inside or outside the range;
+// split one that doesn't first, with uvmsplit().
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-  uint64 a;
+  uint64 a, end, n;
   pte_t *pte;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
-  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
+  end = va + npages*PGSIZE;
+  for(a = va; a < end; a += n){
+    n = PGSIZE;
     if((pte = walk(pagetable, a, 0)) == 0)
       panic("uvmunmap: walk");
+    if(*pte & PTE_S){
+      if(do_free)
+        slotfree(PTE2SLOT(*pte));
+      *pte = 0;
+      continue;
+    }
     if((*pte & PTE_V) == 0)
       panic("uvmunmap: not mapped");
     if(PTE_FLAGS(*pte) == PTE_V)
       panic("uvmunmap: not a leaf");
+    if(*pte & PTE_MEGA){
+      if(a % MEGAPGSIZE != 0 || end - a < MEGAPGSIZE)
+        panic("uvmunmap: part of a megapage");
+      n = MEGAPGSIZE;
+    }
     if(do_free){
       uint64 pa = PTE2PA(*pte);
-      kfree((void*)pa);
+      kfreeorder((void*)pa, n == MEGAPGSIZE ? MEGAORDER : 0);
     }
     *pte = 0;
   }
@@ -195,7 +423,7 @@ uvmcreate()
   pagetable = (pagetable_t) kalloc();
   if(pagetable == 0)
     return 0;
-  memset(pagetable, 0, PGSIZE);
+  pgzero(pagetable);
   return pagetable;
 }
 
@@ -210,31 +438,47 @@ uvminit(pagetable_t pagetable, uchar *src, uint sz)
   if(sz >= PGSIZE)
     panic("inituvm: more than a page");
   mem = kalloc();
-  memset(mem, 0, PGSIZE);
+  pgzero(mem);
   mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W|PTE_R|PTE_X|PTE_U);
   memmove(mem, src, sz);
 }
 
 // Allocate PTEs and physical memory to grow process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
+// Each whole, aligned 2MB of the new memory is a megapage if the
+// allocator has one free. The caller must kvmsync() afterwards.
 uint64
 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 {
   char *mem;
-  uint64 a;
+  uint64 a, i, n;
+  int perm = PTE_W|PTE_X|PTE_R|PTE_U;
 
   if(newsz < oldsz)
     return oldsz;
 
   oldsz = PGROUNDUP(oldsz);
-  for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+  for(a = oldsz; a < newsz; a += n){
+    n = PGSIZE;
+    if(a % MEGAPGSIZE == 0 && newsz - a >= MEGAPGSIZE && megaready(pagetable, a) &&
+       (mem = kallocorder(MEGAORDER)) != 0){
+      for(i = 0; i < MEGAPGSIZE; i += PGSIZE)
+        pgzero(mem + i);
+      if(mapmega(pagetable, a, (uint64)mem, perm) != 0){
+        kfreeorder(mem, MEGAORDER);
+        uvmdealloc(pagetable, a, oldsz);
+        return 0;
+      }
+      n = MEGAPGSIZE;
+      continue;
+    }
+    mem = swapalloc();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
-    if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_W|PTE_X|PTE_R|PTE_U) != 0){
+    pgzero(mem);
+    if(mappages(pagetable, a, PGSIZE, (uint64)mem, perm) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
       return 0;
@@ -294,27 +538,54 @@ uvmfree(pagetable_t pagetable, uint64 sz)
 // Given a parent process's page table, copy
 // its memory into a child's page table.
 // Copies both the page table and the
-// physical memory.
+// physical memory. A megapage stays one in
+// the child if a free one can be had, and is
+// copied into ordinary pages otherwise. A page
+// in swap is read straight into the child's copy.
+// The caller must hold the vm lock of the process
+// whose page table old is.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 {
   pte_t *pte;
-  uint64 pa, i;
+  uint64 pa, i, n;
   uint flags;
   char *mem;
 
-  for(i = 0; i < sz; i += PGSIZE){
+  for(i = 0; i < sz; i += n){
+    n = PGSIZE;
     if((pte = walk(old, i, 0)) == 0)
       panic("uvmcopy: pte should exist");
-    if((*pte & PTE_V) == 0)
-      panic("uvmcopy: page not present");
-    pa = PTE2PA(*pte);
-    flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
+    if(*pte & PTE_MEGA){
+      if(i % MEGAPGSIZE == 0 && sz - i >= MEGAPGSIZE &&
+         (mem = kallocorder(MEGAORDER)) != 0){
+        memmove(mem, (char*)PTE2PA(*pte), MEGAPGSIZE);
+        if(mapmega(new, i, (uint64)mem, PTE_FLAGS(*pte) & ~PTE_MEGA) != 0){
+          kfreeorder(mem, MEGAORDER);
+          goto err;
+        }
+        n = MEGAPGSIZE;
+        continue;
+      }
+    }
+    // swapalloc() may page out more of old, so look
+    // at the PTE only once it has returned.
+    if((mem = swapalloc()) == 0)
       goto err;
-    memmove(mem, (char*)pa, PGSIZE);
+    flags = PTE_FLAGS(*pte) & ~(PTE_MEGA|PTE_S);
+    if(*pte & PTE_S){
+      swapread(PTE2SLOT(*pte), mem);
+      flags |= PTE_V;
+    } else if(*pte & PTE_V){
+      pa = PTE2PA(*pte);
+      if(*pte & PTE_MEGA)
+        pa += i % MEGAPGSIZE;
+      pgcopy(mem, (char*)pa);
+    } else {
+      panic("uvmcopy: page not present");
+    }
     if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
       kfree(mem);
       goto err;
@@ -329,6 +600,8 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 
 // mark a PTE invalid for user access.
 // used by exec for the user stack guard page.
+// clearing PTE_R and PTE_W as well makes the kernel's
+// direct accesses to the page fault too.
 void
 uvmclear(pagetable_t pagetable, uint64 va)
 {
@@ -337,7 +610,48 @@ uvmclear(pagetable_t pagetable, uint64 va)
   pte = walk(pagetable, va, 0);
   if(pte == 0)
     panic("uvmclear");
-  *pte &= ~PTE_U;
+  if(*pte & PTE_MEGA){
+    if(demote(pte) < 0)
+      panic("uvmclear: demote");
+    pte = walk(pagetable, va, 0);
+  }
+  *pte &= ~(PTE_U | PTE_R | PTE_W);
+}
+
+// Is [va, va+len) in the memory of the current process,
+// whose page table is pagetable? If so, the kernel can
+// reach it with copyuser() through the process's kernel
+// page table.
+static int
+isuser(pagetable_t pagetable, uint64 va, uint64 len)
+{
+  struct proc *p = myproc();
+
+  return p != 0 && pagetable == p->pagetable && va < p->sz && len <= p->sz - va;
+}
+
+// Find user page va0 in pagetable for the slow paths of
+// copyout() and friends, reading it back from swap if need
+// be. Returns its physical address, or 0 if there's no such
+// page. On success, interrupts are off, so that the process
+// keeps running and the page can't be paged out; the caller
+// must pop_off() once it has finished with the page.
+static uint64
+uvmhold(pagetable_t pagetable, uint64 va0)
+{
+  uint64 pa;
+  int locked;
+
+  for(;;){
+    push_off();
+    if((pa = walkaddr(pagetable, va0)) != 0)
+      return pa;
+    // swapin() sleeps, which a caller holding a lock can't.
+    locked = mycpu()->noff > 1;
+    pop_off();
+    if(locked || swapin(pagetable, va0) < 0)
+      return 0;
+  }
 }
 
 // Copy from kernel to user.
@@ -348,15 +662,20 @@ copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
 {
   uint64 n, va0, pa0;
 
+  if(isuser(pagetable, dstva, len) && copyuser((void*)dstva, src, len) == 0)
+    return 0;
+
+  // the slow way, through the direct map, for other page
+  // tables or if copyuser() faulted.
   while(len > 0){
     va0 = PGROUNDDOWN(dstva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if((pa0 = uvmhold(pagetable, va0)) == 0)
       return -1;
     n = PGSIZE - (dstva - va0);
     if(n > len)
       n = len;
     memmove((void *)(pa0 + (dstva - va0)), src, n);
+    pop_off();
 
     len -= n;
     src += n;
@@ -373,15 +692,18 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 {
   uint64 n, va0, pa0;
 
+  if(isuser(pagetable, srcva, len) && copyuser(dst, (void*)srcva, len) == 0)
+    return 0;
+
   while(len > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if((pa0 = uvmhold(pagetable, va0)) == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
     if(n > len)
       n = len;
     memmove(dst, (void *)(pa0 + (srcva - va0)), n);
+    pop_off();
 
     len -= n;
     dst += n;
@@ -400,10 +722,15 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
   uint64 n, va0, pa0;
   int got_null = 0;
 
+  if(isuser(pagetable, srcva, 1)){
+    n = myproc()->sz - srcva;
+    if(copyuserstr(dst, (char*)srcva, n < max ? n : max) == 0)
+      return 0;
+  }
+
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if((pa0 = uvmhold(pagetable, va0)) == 0)
       return -1;
     n = PGSIZE - (srcva - va0);
     if(n > max)
@@ -423,6 +750,7 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
       p++;
       dst++;
     }
+    pop_off();
 
     srcva = va0 + PGSIZE;
   }
@@ -0,0 +1,2 @@
+// options for waitpid()
+#define WNOHANG 1   // return 0 if no child has exited
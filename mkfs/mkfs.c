@@ -15,10 +15,11 @@
 #define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
 #endif
 
-#define NINODES 200
+#define NINODES 4000
 
 // Disk layout:
-// [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
+// [ boot block | sb block | log | inode blocks | free bit map | data blocks |
+//   swap area ]
 
 int nbitmap = FSSIZE/(BSIZE*8) + 1;
 int ninodeblocks = NINODES / IPB + 1;
@@ -31,6 +32,7 @@ struct superblock sb;
 char zeroes[BSIZE];
 uint freeinode = 1;
 uint freeblock;
+int hashdirs;  // -h: make hashed directories
 
 
 void balloc(int);
@@ -40,6 +42,7 @@ void rinode(uint inum, struct dinode *ip);
 void rsect(uint sec, void *buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void *p, int n);
+void mkdirents(uint inum, struct dirent *de, int n);
 void die(const char *);
 
 // convert to intel byte order
@@ -69,16 +72,20 @@ int
 main(int argc, char *argv[])
 {
   int i, cc, fd;
-  uint rootino, inum, off;
-  struct dirent de;
+  uint rootino, inum;
+  struct dirent *de, *root;
   char buf[BSIZE];
-  struct dinode din;
 
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
+  if(argc > 1 && strcmp(argv[1], "-h") == 0){
+    hashdirs = 1;
+    argc--;
+    argv++;
+  }
   if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+    fprintf(stderr, "Usage: mkfs [-h] fs.img files...\n");
     exit(1);
   }
 
@@ -101,6 +108,9 @@ main(int argc, char *argv[])
   sb.logstart = xint(2);
   sb.inodestart = xint(2+nlog);
   sb.bmapstart = xint(2+nlog+ninodeblocks);
+  sb.flags = xint(hashdirs ? FS_HASHDIR : 0);
+  sb.swapstart = xint(FSSIZE);
+  sb.nswap = xint(SWAPSIZE);
 
   printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
          nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
@@ -109,6 +119,10 @@ main(int argc, char *argv[])
 
   for(i = 0; i < FSSIZE; i++)
     wsect(i, zeroes);
+  // the kernel never reads a swap block it hasn't
+  // written, so leave the swap area a hole in fs.img.
+  if(SWAPSIZE > 0)
+    wsect(FSSIZE + SWAPSIZE - 1, zeroes);
 
   memset(buf, 0, sizeof(buf));
   memmove(buf, &sb, sizeof(sb));
@@ -117,25 +131,24 @@ main(int argc, char *argv[])
   rootino = ialloc(T_DIR);
   assert(rootino == ROOTINO);
 
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, ".");
-  iappend(rootino, &de, sizeof(de));
-
-  bzero(&de, sizeof(de));
-  de.inum = xshort(rootino);
-  strcpy(de.name, "..");
-  iappend(rootino, &de, sizeof(de));
+  // collect the root directory's entries, to be
+  // written out once they are all known.
+  root = calloc(argc, sizeof(*root));
+  de = root;
+  de->inum = xshort(rootino);
+  strcpy(de->name, ".");
+  de++;
+  de->inum = xshort(rootino);
+  strcpy(de->name, "..");
+  de++;
 
   for(i = 2; i < argc; i++){
-    // get rid of "user/"
+    // get rid of "user/", "kernel/", &c.
     char *shortname;
-    if(strncmp(argv[i], "user/", 5) == 0)
-      shortname = argv[i] + 5;
+    if((shortname = rindex(argv[i], '/')) != 0)
+      shortname++;
     else
       shortname = argv[i];
-    
-    assert(index(shortname, '/') == 0);
 
     if((fd = open(argv[i], 0)) < 0)
       die(argv[i]);
@@ -149,10 +162,9 @@ main(int argc, char *argv[])
 
     inum = ialloc(T_FILE);
 
-    bzero(&de, sizeof(de));
-    de.inum = xshort(inum);
-    strncpy(de.name, shortname, DIRSIZ);
-    iappend(rootino, &de, sizeof(de));
+    de->inum = xshort(inum);
+    strncpy(de->name, shortname, DIRSIZ);
+    de++;
 
     while((cc = read(fd, buf, sizeof(buf))) > 0)
       iappend(inum, buf, cc);
@@ -160,12 +172,7 @@ main(int argc, char *argv[])
     close(fd);
   }
 
-  // fix size of root inode dir
-  rinode(rootino, &din);
-  off = xint(din.size);
-  off = ((off/BSIZE) + 1) * BSIZE;
-  din.size = xint(off);
-  winode(rootino, &din);
+  mkdirents(rootino, root, de - root);
 
   balloc(freeblock);
 
@@ -293,6 +300,84 @@ iappend(uint inum, void *xp, int n)
   winode(inum, &din);
 }
 
+// must match dirhash() in kernel/fs.c.
+uint
+dirhash(char *name)
+{
+  uint h = 2166136261;
+  int i;
+
+  for(i = 0; i < DIRSIZ && name[i]; i++){
+    h ^= (uchar)name[i];
+    h *= 16777619;
+  }
+  return h;
+}
+
+int
+hashcmp(const void *a, const void *b)
+{
+  uint ha = dirhash(((struct dirent*)a)->name);
+  uint hb = dirhash(((struct dirent*)b)->name);
+
+  return ha < hb ? -1 : ha > hb;
+}
+
+// Write the n entries in de as the contents of directory inum.
+// A hashed directory gets an index block, then the entries in
+// hash order, half filling each block to leave room to grow.
+void
+mkdirents(uint inum, struct dirent *de, int n)
+{
+  struct dxentry dx[NDXENTRY+1];
+  struct dirent blk[DPB];
+  struct dinode din;
+  uint off;
+  int i, j;
+
+  if(!hashdirs){
+    iappend(inum, de, n * sizeof(*de));
+    // fix size of the directory
+    rinode(inum, &din);
+    off = xint(din.size);
+    off = ((off/BSIZE) + 1) * BSIZE;
+    din.size = xint(off);
+    winode(inum, &din);
+    return;
+  }
+
+  qsort(de, n, sizeof(*de), hashcmp);
+  bzero(dx, sizeof(dx));
+  for(i = 0; i < n; i = j){
+    // don't split names with the same hash across blocks.
+    for(j = i + DPB/2; j < n && dirhash(de[j].name) == dirhash(de[j-1].name); j++)
+      ;
+    if(j > n)
+      j = n;
+    assert(j - i <= DPB);
+    dx[0].blk++;
+    assert(dx[0].blk <= NDXENTRY);
+    dx[dx[0].blk].blk = xshort(dx[0].blk);
+    dx[dx[0].blk].hash = i == 0 ? 0 : xint(dirhash(de[i].name));
+  }
+  dx[0].blk = xshort(dx[0].blk);
+  iappend(inum, dx, sizeof(dx));
+
+  for(i = 0; i < n; i = j){
+    for(j = i + DPB/2; j < n && dirhash(de[j].name) == dirhash(de[j-1].name); j++)
+      ;
+    if(j > n)
+      j = n;
+    bzero(blk, sizeof(blk));
+    memmove(blk, de + i, (j - i) * sizeof(*de));
+    iappend(inum, blk, sizeof(blk));
+  }
+
+  rinode(inum, &din);
+  din.major = xshort(DIR_HASHED);
+  winode(inum, &din);
+}
+
 void
 die(const char *s)
 {
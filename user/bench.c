@@ -0,0 +1,436 @@
+// Time common operations: process creation (fork and
+// exec, or spawn), pipes,
+// small and large files, memory growth, TLB reach,
+// malloc(), and context switches. Prints one result per line, as
+//
+//   bench <name> <parameter> <value> <unit>
+//
+// for scripts to compare across runs; see "make bench".
+// Times come from the timer CSR (10 MHz on qemu).
+//
+// usage: bench [name]
+
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "kernel/fcntl.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define MHZ 10   // timer ticks per microsecond
+
+char buf[4096];
+char *self;
+
+void
+die(char *what)
+{
+  fprintf(2, "bench: %s failed\n", what);
+  exit(1);
+}
+
+void
+result(char *name, int param, uint64 value, char *unit)
+{
+  printf("bench %s %d %l %s\n", name, param, value, unit);
+}
+
+// Average nanoseconds per op.
+void
+perop(char *name, int param, uint64 t, int n)
+{
+  result(name, param, t * 1000 / MHZ / n, "ns");
+}
+
+// Kilobytes per second.
+void
+rate(char *name, int param, uint64 t, uint64 bytes)
+{
+  if(t == 0)
+    t = 1;
+  result(name, param, bytes * MHZ * 1000000 / 1024 / t, "KB/s");
+}
+
+// fork() and exit() with nidle other children alive, which
+// shouldn't slow either down.
+void
+forkexitrun(int nidle)
+{
+  enum { N = 200 };
+  uint64 t0;
+  int i, pid, fds[2];
+  char c;
+
+  if(pipe(fds) < 0)
+    die("pipe");
+  for(i = 0; i < nidle; i++){
+    if((pid = fork()) < 0)
+      die("fork");
+    if(pid == 0){
+      close(fds[1]);
+      read(fds[0], &c, 1);
+      exit(0);
+    }
+  }
+  close(fds[0]);
+
+  t0 = r_time();
+  for(i = 0; i < N; i++){
+    if((pid = fork()) < 0)
+      die("fork");
+    if(pid == 0)
+      exit(0);
+    waitpid(pid, 0, 0);
+  }
+  perop("forkexit", nidle, r_time() - t0, N);
+
+  close(fds[1]);
+  for(i = 0; i < nidle; i++)
+    wait(0);
+}
+
+void
+forkexit(void)
+{
+  forkexitrun(0);
+  forkexitrun(48);
+  forkexitrun(400);
+}
+
+// Start this program N times, by fork() and exec() or by
+// spawn(), with heap KB of memory that fork() must copy.
+void
+startrun(char *name, int heap, int usespawn)
+{
+  enum { N = 50 };
+  char *argv[] = { self, "-nop", 0 };
+  uint64 t0;
+  int i, pid;
+
+  if(sbrk(heap*1024) == (char*)-1)
+    die("sbrk");
+  t0 = r_time();
+  for(i = 0; i < N; i++){
+    if(usespawn){
+      if(spawn(self, argv, 0, 0) < 0)
+        die("spawn");
+    } else {
+      if((pid = fork()) < 0)
+        die("fork");
+      if(pid == 0){
+        exec(self, argv);
+        die("exec");
+      }
+    }
+    wait(0);
+  }
+  perop(name, heap, r_time() - t0, N);
+  sbrk(-heap*1024);
+}
+
+void
+forkexec(void)
+{
+  startrun("forkexec", 0, 0);
+  startrun("forkexec", 8192, 0);
+}
+
+void
+spawnbench(void)
+{
+  startrun("spawn", 0, 1);
+  startrun("spawn", 8192, 1);
+}
+
+void
+pipethroughput(void)
+{
+  enum { TOTAL = 4*1024*1024 };
+  int fds[2], n, size, pid;
+  uint64 t0, got;
+
+  for(size = 64; size <= sizeof(buf); size *= 8){
+    if(pipe(fds) < 0)
+      die("pipe");
+    t0 = r_time();
+    if((pid = fork()) < 0)
+      die("fork");
+    if(pid == 0){
+      close(fds[0]);
+      for(got = 0; got < TOTAL; got += size)
+        if(write(fds[1], buf, size) != size)
+          die("pipe write");
+      exit(0);
+    }
+    close(fds[1]);
+    for(got = 0; (n = read(fds[0], buf, sizeof(buf))) > 0; got += n)
+      ;
+    close(fds[0]);
+    wait(0);
+    if(got != TOTAL)
+      die("pipe read");
+    rate("pipe", size, r_time() - t0, TOTAL);
+  }
+}
+
+// create, write, close, and unlink small files in dir.
+void
+smallfiles(char *name, char *dir)
+{
+  enum { N = 100 };
+  char path[32];
+  uint64 t0;
+  int i, fd;
+
+  strcpy(path, dir);
+  strcpy(path + strlen(path), "/benchf");
+  t0 = r_time();
+  for(i = 0; i < N; i++){
+    if((fd = open(path, O_CREATE|O_WRONLY)) < 0)
+      die("create");
+    if(write(fd, buf, 100) != 100)
+      die("write");
+    close(fd);
+    if(unlink(path) < 0)
+      die("unlink");
+  }
+  perop(name, 0, r_time() - t0, N);
+}
+
+// write, then read back, the biggest file the disk allows.
+void
+bigfile(char *wname, char *rname, char *path)
+{
+  enum { SIZE = 256*1024 };
+  uint64 t0;
+  int fd, n;
+
+  if((fd = open(path, O_CREATE|O_TRUNC|O_WRONLY)) < 0)
+    die("create");
+  t0 = r_time();
+  for(n = 0; n < SIZE; n += sizeof(buf))
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf))
+      die("write");
+  close(fd);
+  rate(wname, SIZE/1024, r_time() - t0, SIZE);
+
+  if((fd = open(path, O_RDONLY)) < 0)
+    die("open");
+  t0 = r_time();
+  for(n = 0; n < SIZE; n += sizeof(buf))
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf))
+      die("read");
+  close(fd);
+  rate(rname, SIZE/1024, r_time() - t0, SIZE);
+  unlink(path);
+}
+
+void
+sbrkbench(void)
+{
+  enum { N = 20, SIZE = 1024*1024 };
+  uint64 t0 = r_time();
+  int i;
+
+  for(i = 0; i < N; i++){
+    if(sbrk(SIZE) == (char*)-1)
+      die("sbrk");
+    sbrk(-SIZE);
+  }
+  perop("sbrk", SIZE/1024, r_time() - t0, N);
+}
+
+// Read one word from every page of [p, p+size), over and
+// over; report the time per read.
+void
+touch(char *name, char *p, int size)
+{
+  enum { ROUNDS = 20 };
+  uint64 t0;
+  int i, j, sum = 0;
+
+  t0 = r_time();
+  for(i = 0; i < ROUNDS; i++)
+    for(j = 0; j < size; j += PGSIZE)
+      sum += p[j];
+  if(sum != 0)
+    die("touch");
+  perop(name, size/1024, r_time() - t0, ROUNDS * (size/PGSIZE));
+}
+
+// The same memory-touching loop over ordinary pages and
+// over megapages. sbrk() maps megapages only for whole,
+// aligned 2MB steps, so growing a page at a time gets
+// ordinary pages.
+void
+tlbbench(void)
+{
+  enum { SIZE = 16*1024*1024 };
+  char *p;
+  int i, pad;
+
+  p = sbrk(0);
+  for(i = 0; i < SIZE; i += PGSIZE)
+    if(sbrk(PGSIZE) == (char*)-1)
+      die("sbrk");
+  touch("tlb-4k", p, SIZE);
+  sbrk(-SIZE);
+
+  pad = MEGAPGSIZE - (uint64)sbrk(0) % MEGAPGSIZE;
+  if(sbrk(pad) == (char*)-1 || (p = sbrk(SIZE)) == (char*)-1)
+    die("sbrk");
+  touch("tlb-2m", p, SIZE);
+  sbrk(-(SIZE + pad));
+}
+
+// Random mallocs and frees of sizes in [min, max), with
+// up to NSLOT blocks live; report the time per call.
+void
+mallocrun(char *name, uint min, uint max)
+{
+  enum { NSLOT = 256, N = 100000 };
+  static char *slot[NSLOT];
+  uint64 t0;
+  uint r = 1;
+  int i, s;
+
+  t0 = r_time();
+  for(i = 0; i < N; i++){
+    r = r * 1103515245 + 12345;
+    s = (r >> 16) % NSLOT;
+    if(slot[s]){
+      free(slot[s]);
+      slot[s] = 0;
+    } else if((slot[s] = malloc(min + (r >> 8) % (max - min))) == 0){
+      die("malloc");
+    }
+  }
+  perop(name, max, r_time() - t0, N);
+  for(s = 0; s < NSLOT; s++){
+    free(slot[s]);
+    slot[s] = 0;
+  }
+}
+
+void
+mallocbench(void)
+{
+  mallocrun("malloc", 16, 512);
+  mallocrun("malloc-large", 4096, 65536);
+}
+
+// pass a byte around a ring of n processes
+// through pipes; report the time per hop.
+void
+ctxswitch(int n)
+{
+  enum { ROUNDS = 200 };
+  int fds[NOFILE][2], i, j, pid;
+  uint64 t0;
+  char c = 0;
+
+  for(i = 0; i < n; i++)
+    if(pipe(fds[i]) < 0)
+      die("pipe");
+  t0 = r_time();
+  for(i = 1; i < n; i++){
+    if((pid = fork()) < 0)
+      die("fork");
+    if(pid == 0){
+      // process i reads from pipe i, writes to i+1.
+      for(j = 0; j < ROUNDS; j++){
+        if(read(fds[i][0], &c, 1) != 1)
+          die("ring read");
+        write(fds[(i+1)%n][1], &c, 1);
+      }
+      exit(0);
+    }
+  }
+  for(j = 0; j < ROUNDS; j++){
+    write(fds[1%n][1], &c, 1);
+    if(read(fds[0][0], &c, 1) != 1)
+      die("ring read");
+  }
+  for(i = 1; i < n; i++)
+    wait(0);
+  perop("ctxsw", n, r_time() - t0, ROUNDS*n);
+  for(i = 0; i < n; i++){
+    close(fds[i][0]);
+    close(fds[i][1]);
+  }
+}
+
+void
+ctxswitches(void)
+{
+  int n;
+
+  // the parent holds both ends of every pipe.
+  for(n = 2; 2*n + 3 <= NOFILE; n += 2)
+    ctxswitch(n);
+}
+
+void
+tmpsmall(void)
+{
+  smallfiles("smallfile-tmp", "/tmp");
+}
+
+void
+disksmall(void)
+{
+  smallfiles("smallfile", ".");
+}
+
+void
+diskbig(void)
+{
+  bigfile("bigwrite", "bigread", "benchbig");
+}
+
+void
+tmpbig(void)
+{
+  bigfile("bigwrite-tmp", "bigread-tmp", "/tmp/benchbig");
+}
+
+struct {
+  char *name;
+  void (*f)(void);
+} benches[] = {
+  { "forkexit", forkexit },
+  { "forkexec", forkexec },
+  { "spawn", spawnbench },
+  { "pipe", pipethroughput },
+  { "smallfile", disksmall },
+  { "smallfile-tmp", tmpsmall },
+  { "bigfile", diskbig },
+  { "bigfile-tmp", tmpbig },
+  { "sbrk", sbrkbench },
+  { "tlb", tlbbench },
+  { "malloc", mallocbench },
+  { "ctxsw", ctxswitches },
+};
+
+int
+main(int argc, char *argv[])
+{
+  int i, found = 0;
+
+  if(argc > 1 && strcmp(argv[1], "-nop") == 0)
+    exit(0);
+  self = argv[0];
+  memset(buf, 'b', sizeof(buf));
+
+  for(i = 0; i < sizeof(benches)/sizeof(benches[0]); i++){
+    if(argc > 1 && strcmp(argv[1], benches[i].name) != 0)
+      continue;
+    found = 1;
+    benches[i].f();
+  }
+  if(!found){
+    fprintf(2, "usage: bench [name]\n");
+    exit(1);
+  }
+  printf("bench done\n");
+  exit(0);
+}
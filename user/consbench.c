@@ -0,0 +1,54 @@
+// Measure console output throughput: write the same bytes
+// to fd 1 with one-byte, line-sized, and page-sized write()s.
+//
+// usage: consbench [kbytes]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+char buf[4096];
+
+// Write n bytes in chunks of size; return the ticks taken.
+int
+run(int n, int size)
+{
+  int t0, i, m;
+
+  t0 = uptime();
+  for(i = 0; i < n; i += m){
+    m = n - i < size ? n - i : size;
+    if(write(1, buf, m) != m){
+      fprintf(2, "consbench: write failed\n");
+      exit(1);
+    }
+  }
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int sizes[] = { 1, 64, sizeof(buf) };
+  int ticks[3];
+  int i, n = 32;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n < 1 || n > 1024){
+    fprintf(2, "usage: consbench [kbytes (1-1024)]\n");
+    exit(1);
+  }
+  n *= 1024;
+
+  // 63 characters and a newline per 64 bytes.
+  for(i = 0; i < sizeof(buf); i++)
+    buf[i] = (i % 64 == 63) ? '\n' : 'a' + (i / 64) % 26;
+
+  for(i = 0; i < 3; i++)
+    ticks[i] = run(n, sizes[i]);
+
+  printf("consbench: %d bytes per run\n", n);
+  for(i = 0; i < 3; i++)
+    printf("%d-byte writes: %d ticks\n", sizes[i], ticks[i]);
+  exit(0);
+}
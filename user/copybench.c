@@ -0,0 +1,93 @@
+// Time system calls that copy between user and kernel
+// memory: pipe transfers in several sizes, reads of a
+// cached file, and fstat().
+//
+// usage: copybench
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define TOTAL (256*1024)   // bytes through the pipe per size
+
+char buf[4096];
+
+// Send TOTAL bytes through a pipe in n-byte writes and reads.
+void
+pipebench(int n)
+{
+  int fds[2], i, m, pid, t0;
+
+  if(pipe(fds) < 0){
+    printf("copybench: pipe failed\n");
+    exit(1);
+  }
+  t0 = uptime();
+  pid = fork();
+  if(pid < 0){
+    printf("copybench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(fds[0]);
+    for(i = 0; i < TOTAL; i += n)
+      write(fds[1], buf, n);
+    exit(0);
+  }
+  close(fds[1]);
+  for(i = 0; i < TOTAL; i += m)
+    if((m = read(fds[0], buf, n)) <= 0)
+      break;
+  close(fds[0]);
+  wait(0);
+  printf("pipe, %d-byte transfers: %d ticks for %d bytes\n", n, uptime() - t0, i);
+}
+
+void
+readbench(void)
+{
+  int fd, i, t0;
+
+  if((fd = open("copybench.tmp", O_CREATE|O_RDWR)) < 0){
+    printf("copybench: create failed\n");
+    exit(1);
+  }
+  for(i = 0; i < 8; i++)
+    write(fd, buf, sizeof(buf));
+  close(fd);
+
+  t0 = uptime();
+  for(i = 0; i < 100; i++){
+    fd = open("copybench.tmp", O_RDONLY);
+    while(read(fd, buf, sizeof(buf)) > 0)
+      ;
+    close(fd);
+  }
+  printf("read 100 x 32KB file: %d ticks\n", uptime() - t0);
+  unlink("copybench.tmp");
+}
+
+void
+statbench(void)
+{
+  struct stat st;
+  int i, t0;
+
+  t0 = uptime();
+  for(i = 0; i < 20000; i++)
+    fstat(0, &st);
+  printf("20000 fstat calls: %d ticks\n", uptime() - t0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  pipebench(1);
+  pipebench(64);
+  pipebench(512);
+  pipebench(4096);
+  readbench();
+  statbench();
+  exit(0);
+}
@@ -0,0 +1,18 @@
+// Print the directory name lookup cache counters.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+int
+main(void)
+{
+  struct dcachestat st;
+
+  if(dcachestat(&st) < 0){
+    fprintf(2, "dcstat: dcachestat failed\n");
+    exit(1);
+  }
+  printf("hits %l negative hits %l misses %l\n", st.hits, st.neghits, st.misses);
+  exit(0);
+}
@@ -0,0 +1,84 @@
+// Create, look up, and remove many files in one directory.
+// On a file system made with mkfs -h the directory is hashed,
+// so the time per file should not grow with the file count.
+//
+// usage: dirbench [nfiles]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define DIR "dirbench.d"
+
+// "dirbench.d/file-with-a-long-name-NNNNN"
+void
+name(char *p, int i)
+{
+  int j;
+
+  strcpy(p, DIR "/file-with-a-long-name-");
+  p += strlen(p);
+  for(j = 4; j >= 0; j--){
+    p[j] = '0' + i % 10;
+    i /= 10;
+  }
+  p[5] = 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[64];
+  int nfiles = 2000;
+  int i, fd, t0, tcreate, tlookup, tunlink;
+
+  if(argc > 1)
+    nfiles = atoi(argv[1]);
+  if(nfiles < 1 || nfiles > 99999){
+    printf("usage: dirbench [nfiles]\n");
+    exit(1);
+  }
+  if(mkdir(DIR) < 0){
+    printf("dirbench: mkdir %s failed\n", DIR);
+    exit(1);
+  }
+
+  t0 = uptime();
+  for(i = 0; i < nfiles; i++){
+    name(path, i);
+    if((fd = open(path, O_CREATE|O_WRONLY)) < 0){
+      printf("dirbench: create failed after %d files\n", i);
+      nfiles = i;
+      break;
+    }
+    close(fd);
+  }
+  tcreate = uptime() - t0;
+
+  t0 = uptime();
+  for(i = nfiles - 1; i >= 0; i--){
+    name(path, i);
+    if((fd = open(path, O_RDONLY)) < 0){
+      printf("dirbench: open %s failed\n", path);
+      exit(1);
+    }
+    close(fd);
+  }
+  tlookup = uptime() - t0;
+
+  t0 = uptime();
+  for(i = 0; i < nfiles; i++){
+    name(path, i);
+    if(unlink(path) < 0){
+      printf("dirbench: unlink %s failed\n", path);
+      exit(1);
+    }
+  }
+  tunlink = uptime() - t0;
+  unlink(DIR);
+
+  printf("dirbench: %d files\n", nfiles);
+  printf("create %d ticks, lookup %d ticks, unlink %d ticks\n",
+         tcreate, tlookup, tunlink);
+  exit(0);
+}
@@ -0,0 +1,43 @@
+// Print the spinlock contention counters,
+// most contended lock names first. Names that
+// didn't fit in the kernel's table add up as "(other)".
+//
+// usage: lockstat
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define N 32
+
+struct lockstat st[N];
+
+int
+main(void)
+{
+  struct lockstat t;
+  int n, i, j;
+
+  if((n = lockstat(st, N)) < 0){
+    fprintf(2, "lockstat: lockstat failed\n");
+    exit(1);
+  }
+
+  // insertion sort by spins.
+  for(i = 1; i < n; i++){
+    t = st[i];
+    for(j = i; j > 0 && st[j-1].nspin < t.nspin; j--)
+      st[j] = st[j-1];
+    st[j] = t;
+  }
+
+  printf("name             locks acquires contended spins maxhold\n");
+  for(i = 0; i < n; i++){
+    printf("%s", st[i].name);
+    for(j = strlen(st[i].name); j < LOCKNAME + 1; j++)
+      printf(" ");
+    printf("%d %l %l %l %l\n", st[i].nlocks, st[i].nacquire,
+           st[i].ncontend, st[i].nspin, st[i].maxhold);
+  }
+  exit(0);
+}
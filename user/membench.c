@@ -0,0 +1,112 @@
+// Measure memset, memmove, and memcmp in bytes per cycle,
+// against plain byte-at-a-time loops, for a few sizes
+// and alignments.
+//
+// usage: membench
+
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define NBYTES (1024*1024)   // bytes moved per measurement
+
+char bufa[PGSIZE + 64], bufb[PGSIZE + 64];
+
+static inline uint64
+rdcycle(void)
+{
+  uint64 x;
+  asm volatile("rdcycle %0" : "=r" (x));
+  return x;
+}
+
+void*
+bytememset(void *dst, int c, uint n)
+{
+  char *d = dst;
+
+  while(n-- > 0)
+    *d++ = c;
+  return dst;
+}
+
+void*
+bytememmove(void *dst, const void *src, int n)
+{
+  char *d = dst;
+  const char *s = src;
+
+  while(n-- > 0)
+    *d++ = *s++;
+  return dst;
+}
+
+int
+bytememcmp(const void *v1, const void *v2, uint n)
+{
+  const char *s1 = v1, *s2 = v2;
+
+  for(; n > 0; n--, s1++, s2++)
+    if(*s1 != *s2)
+      return *s1 - *s2;
+  return 0;
+}
+
+// print bytes per cycle with two decimals.
+void
+report(char *what, int n, int aoff, int boff, uint64 cycles)
+{
+  uint64 r = (uint64)NBYTES * 100 / (cycles ? cycles : 1);
+
+  printf("%s %d bytes, offsets %d/%d: %d.%d%d bytes/cycle\n",
+         what, n, aoff, boff, (int)(r / 100), (int)(r / 10 % 10), (int)(r % 10));
+}
+
+void
+bench(int n, int aoff, int boff)
+{
+  char *a = bufa + aoff, *b = bufb + boff;
+  int i, iters = NBYTES / n;
+  uint64 t;
+
+  t = rdcycle();
+  for(i = 0; i < iters; i++)
+    bytememset(a, i, n);
+  report("byte memset ", n, aoff, boff, rdcycle() - t);
+  t = rdcycle();
+  for(i = 0; i < iters; i++)
+    memset(a, i, n);
+  report("memset      ", n, aoff, boff, rdcycle() - t);
+
+  t = rdcycle();
+  for(i = 0; i < iters; i++)
+    bytememmove(a, b, n);
+  report("byte memmove", n, aoff, boff, rdcycle() - t);
+  t = rdcycle();
+  for(i = 0; i < iters; i++)
+    memmove(a, b, n);
+  report("memmove     ", n, aoff, boff, rdcycle() - t);
+
+  // equal buffers, so the whole length is compared.
+  t = rdcycle();
+  for(i = 0; i < iters; i++)
+    if(bytememcmp(a, b, n) != 0)
+      break;
+  report("byte memcmp ", n, aoff, boff, rdcycle() - t);
+  t = rdcycle();
+  for(i = 0; i < iters; i++)
+    if(memcmp(a, b, n) != 0)
+      break;
+  report("memcmp      ", n, aoff, boff, rdcycle() - t);
+}
+
+int
+main(int argc, char *argv[])
+{
+  memset(bufb, 'b', sizeof(bufb));
+  bench(PGSIZE, 0, 0);   // whole, aligned pages
+  bench(1000, 3, 3);     // misaligned, but alike
+  bench(1000, 1, 2);     // differently aligned
+  bench(64, 0, 0);       // small
+  exit(0);
+}
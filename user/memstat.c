@@ -0,0 +1,28 @@
+// Print free physical memory by buddy block size,
+// to show how fragmented it is, and swap usage.
+//
+// usage: memstat
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+int
+main(void)
+{
+  struct memstat st;
+  int i;
+
+  if(memstat(&st) < 0){
+    fprintf(2, "memstat: memstat failed\n");
+    exit(1);
+  }
+  printf("%l of %l pages free\n", st.nfree, st.npage);
+  printf("order pages blocks\n");
+  for(i = 0; i <= MAXORDER; i++)
+    printf("%d %d %d\n", i, 1 << i, st.nblock[i]);
+  if(st.nswap)
+    printf("swap: %l of %l pages used, %l out, %l in\n",
+           st.swapused, st.nswap, st.pageout, st.pagein);
+  exit(0);
+}
@@ -6,21 +6,17 @@
 
 static char digits[] = "0123456789ABCDEF";
 
+// callers pass an int for %d, which arrives sign-extended,
+// so sgn can treat xx as a signed 64-bit value.
 static void
-putc(int fd, char c)
+printint(int fd, uint64 xx, int base, int sgn)
 {
-  write(fd, &c, 1);
-}
-
-static void
-printint(int fd, int xx, int base, int sgn)
-{
-  char buf[16];
+  char buf[24];
   int i, neg;
-  uint x;
+  uint64 x;
 
   neg = 0;
-  if(sgn && xx < 0){
+  if(sgn && (long)xx < 0){
     neg = 1;
     x = -xx;
   } else {
@@ -35,19 +31,20 @@ printint(int fd, int xx, int base, int sgn)
     buf[i++] = '-';
 
   while(--i >= 0)
-    putc(fd, buf[i]);
+    fputc(fd, buf[i]);
 }
 
 static void
 printptr(int fd, uint64 x) {
   int i;
-  putc(fd, '0');
-  putc(fd, 'x');
+  fputc(fd, '0');
+  fputc(fd, 'x');
   for (i = 0; i < (sizeof(uint64) * 2); i++, x <<= 4)
-    putc(fd, digits[x >> (sizeof(uint64) * 8 - 4)]);
+    fputc(fd, digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
-// Print to the given fd. Only understands %d, %x, %p, %s.
+// Print to the given fd, through stdio.c's buffering.
+// Only understands %d, %l (a uint64), %x, %p, %s, %c.
 void
 vprintf(int fd, const char *fmt, va_list ap)
 {
@@ -61,7 +58,7 @@ vprintf(int fd, const char *fmt, va_list ap)
       if(c == '%'){
         state = '%';
       } else {
-        putc(fd, c);
+        fputc(fd, c);
       }
     } else if(state == '%'){
       if(c == 'd'){
@@ -69,7 +66,7 @@ vprintf(int fd, const char *fmt, va_list ap)
       } else if(c == 'l') {
         printint(fd, va_arg(ap, uint64), 10, 0);
       } else if(c == 'x') {
-        printint(fd, va_arg(ap, int), 16, 0);
+        printint(fd, va_arg(ap, uint), 16, 0);
       } else if(c == 'p') {
         printptr(fd, va_arg(ap, uint64));
       } else if(c == 's'){
@@ -77,21 +74,22 @@ vprintf(int fd, const char *fmt, va_list ap)
         if(s == 0)
           s = "(null)";
         while(*s != 0){
-          putc(fd, *s);
+          fputc(fd, *s);
           s++;
         }
       } else if(c == 'c'){
-        putc(fd, va_arg(ap, uint));
+        fputc(fd, va_arg(ap, uint));
       } else if(c == '%'){
-        putc(fd, c);
+        fputc(fd, c);
       } else {
         // Unknown % sequence.  Print it to draw attention.
-        putc(fd, '%');
-        putc(fd, c);
+        fputc(fd, '%');
+        fputc(fd, c);
       }
       state = 0;
     }
   }
+  fdone(fd);
 }
 
 void
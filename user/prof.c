@@ -0,0 +1,201 @@
+// Run a command under the sampling profiler and print
+// a flat profile: where the samples landed, by function,
+// in the kernel (from /kernel.sym) and in the command
+// (from its .sym file).
+//
+// usage: prof command [args...]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+#define NBUF 256    // samples read at a time
+#define NTOP 30     // functions to print
+
+struct sym {
+  uint64 addr;
+  char *name;
+  int count;
+};
+
+struct symtab {
+  struct sym *sym;
+  int n;
+};
+
+struct symtab ktab, utab;
+struct profsample buf[NBUF];
+
+// Read a symbol file: lines of "hexaddress name".
+// Returns 0 if it can't be read.
+int
+loadsyms(char *path, struct symtab *t)
+{
+  struct stat st;
+  char *text, *p, *e, *name;
+  uint64 a;
+  int fd, n, i, j;
+  struct sym s;
+
+  if((fd = open(path, O_RDONLY)) < 0)
+    return 0;
+  if(fstat(fd, &st) < 0 || (text = malloc(st.size + 1)) == 0){
+    close(fd);
+    return 0;
+  }
+  n = read(fd, text, st.size);
+  close(fd);
+  if(n < 0)
+    return 0;
+  text[n] = 0;
+
+  for(n = 0, p = text; *p; p++)
+    if(*p == '\n')
+      n++;
+  t->sym = malloc((n + 1) * sizeof(struct sym));
+  t->n = 0;
+
+  for(p = text; *p; p = e){
+    for(e = p; *e && *e != '\n'; e++)
+      ;
+    if(*e)
+      *e++ = 0;
+    a = 0;
+    for(; (*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f'); p++)
+      a = a*16 + (*p <= '9' ? *p - '0' : *p - 'a' + 10);
+    if(*p != ' ')
+      continue;
+    name = p + 1;
+    // section and file names aren't functions.
+    if(name[0] == '.' || strchr(name, '.') || a == 0)
+      continue;
+    t->sym[t->n].addr = a;
+    t->sym[t->n].name = name;
+    t->sym[t->n].count = 0;
+    t->n++;
+  }
+
+  // insertion sort by address.
+  for(i = 1; i < t->n; i++){
+    s = t->sym[i];
+    for(j = i; j > 0 && t->sym[j-1].addr > s.addr; j--)
+      t->sym[j] = t->sym[j-1];
+    t->sym[j] = s;
+  }
+  return 1;
+}
+
+// The symbol at or before pc, or 0.
+struct sym*
+lookup(struct symtab *t, uint64 pc)
+{
+  int lo = 0, hi = t->n - 1, mid;
+
+  if(t->n == 0 || pc < t->sym[0].addr)
+    return 0;
+  while(lo < hi){
+    mid = (lo + hi + 1) / 2;
+    if(t->sym[mid].addr <= pc)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+  return &t->sym[lo];
+}
+
+int
+main(int argc, char *argv[])
+{
+  char path[64];
+  int pid, n, i, j, total = 0, kunknown = 0, uunknown = 0, other = 0;
+  struct sym *s, *top[NTOP];
+  int ntop = 0;
+
+  if(argc < 2){
+    fprintf(2, "usage: prof command [args...]\n");
+    exit(1);
+  }
+  if(!loadsyms("/kernel.sym", &ktab))
+    fprintf(2, "prof: can't read /kernel.sym\n");
+  path[0] = 0;
+  if(argv[1][0] != '/')
+    strcpy(path, "/");
+  if(strlen(path) + strlen(argv[1]) + 5 > sizeof(path)){
+    fprintf(2, "prof: name too long\n");
+    exit(1);
+  }
+  strcpy(path + strlen(path), argv[1]);
+  strcpy(path + strlen(path), ".sym");
+  if(!loadsyms(path, &utab))
+    fprintf(2, "prof: can't read %s\n", path);
+
+  if(prof(PROF_START, 0, 0) < 0){
+    fprintf(2, "prof: can't start profiling\n");
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "prof: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], argv + 1);
+    fprintf(2, "prof: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  prof(PROF_STOP, 0, 0);
+
+  while((n = prof(PROF_READ, buf, NBUF)) > 0){
+    for(i = 0; i < n; i++){
+      total++;
+      if(buf[i].user && buf[i].pid != pid){
+        other++;
+      } else if(buf[i].user){
+        if((s = lookup(&utab, buf[i].pc)) != 0)
+          s->count++;
+        else
+          uunknown++;
+      } else {
+        if((s = lookup(&ktab, buf[i].pc)) != 0)
+          s->count++;
+        else
+          kunknown++;
+      }
+    }
+  }
+
+  // the NTOP busiest functions, most samples first.
+  for(j = 0; j < 2; j++){
+    struct symtab *t = j == 0 ? &ktab : &utab;
+    for(s = t->sym; s < &t->sym[t->n]; s++){
+      if(s->count == 0)
+        continue;
+      for(i = ntop; i > 0 && top[i-1]->count < s->count; i--)
+        if(i < NTOP)
+          top[i] = top[i-1];
+      if(i < NTOP){
+        top[i] = s;
+        if(ntop < NTOP)
+          ntop++;
+      }
+    }
+  }
+
+  printf("prof: %d samples\n", total);
+  printf("samples    %%  function\n");
+  for(i = 0; i < ntop; i++){
+    s = top[i];
+    printf("%d %d %s%s\n", s->count, s->count * 100 / total,
+           s >= ktab.sym && s < &ktab.sym[ktab.n] ? "kernel " : "", s->name);
+  }
+  if(kunknown)
+    printf("%d kernel, unknown\n", kunknown);
+  if(uunknown)
+    printf("%d %s, unknown\n", uunknown, argv[1]);
+  if(other)
+    printf("%d other processes\n", other);
+  exit(0);
+}
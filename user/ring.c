@@ -0,0 +1,100 @@
+// User side of the system call ring (see kernel/ring.c).
+//
+// Queue operations with ringread() &c, run them all with
+// one trap with ringsubmit(), then collect the results
+// with ringreap(). Each operation carries a data word
+// that comes back with its completion.
+
+#include "kernel/types.h"
+#include "kernel/ring.h"
+#include "user/user.h"
+
+static struct ring *ring;
+
+// Map the ring. Returns 0 on success, -1 on failure.
+int
+ringinit(void)
+{
+  if(ring)
+    return 0;
+  ring = ringsetup();
+  if(ring == (struct ring*)-1){
+    ring = 0;
+    return -1;
+  }
+  return 0;
+}
+
+// Queue one submission.
+// Returns -1 if the ring isn't set up or the queue is full.
+static int
+ringprep(int op, int fd, uint64 addr, int n, uint64 data)
+{
+  struct ringsqe *e;
+
+  if(ring == 0 || ring->sqtail - ring->sqhead >= NRING)
+    return -1;
+  e = &ring->sq[ring->sqtail % NRING];
+  e->op = op;
+  e->fd = fd;
+  e->addr = addr;
+  e->n = n;
+  e->data = data;
+  // the entry must be complete before the kernel can see it.
+  __sync_synchronize();
+  ring->sqtail++;
+  return 0;
+}
+
+int
+ringread(int fd, void *buf, int n, uint64 data)
+{
+  return ringprep(RING_READ, fd, (uint64)buf, n, data);
+}
+
+int
+ringwrite(int fd, const void *buf, int n, uint64 data)
+{
+  return ringprep(RING_WRITE, fd, (uint64)buf, n, data);
+}
+
+int
+ringopen(const char *path, int omode, uint64 data)
+{
+  return ringprep(RING_OPEN, 0, (uint64)path, omode, data);
+}
+
+int
+ringclose(int fd, uint64 data)
+{
+  return ringprep(RING_CLOSE, fd, 0, 0, data);
+}
+
+// Ask the kernel to run every queued submission.
+// Returns the number it consumed, or -1.
+int
+ringsubmit(void)
+{
+  if(ring == 0)
+    return -1;
+  return ringenter(ring->sqtail - ring->sqhead);
+}
+
+// Take the oldest completion.
+// Returns 0 and sets *data and *res, or -1 if there is none.
+int
+ringreap(uint64 *data, int *res)
+{
+  struct ringcqe *c;
+
+  if(ring == 0 || ring->cqhead == ring->cqtail)
+    return -1;
+  __sync_synchronize();
+  c = &ring->cq[ring->cqhead % NRING];
+  if(data)
+    *data = c->data;
+  if(res)
+    *res = c->res;
+  ring->cqhead++;
+  return 0;
+}
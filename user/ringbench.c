@@ -0,0 +1,161 @@
+// Compare small-file I/O through plain system calls
+// against the same work batched through the system call ring.
+//
+// usage: ringbench [nfiles]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define BATCH 16   // files per ring submission
+#define FSIZE 64   // bytes per file
+
+char data[FSIZE];
+char buf[BATCH][FSIZE];
+int fds[BATCH];
+
+void
+name(char *p, int i)
+{
+  p[0] = 'r';
+  p[1] = 'b';
+  p[2] = '0' + (i / 100) % 10;
+  p[3] = '0' + (i / 10) % 10;
+  p[4] = '0' + i % 10;
+  p[5] = 0;
+}
+
+// Reap n completions into res[], indexed by their data word.
+void
+reap(int n, int *res)
+{
+  uint64 d;
+  int r;
+
+  while(n > 0){
+    if(ringreap(&d, &r) < 0){
+      printf("ringbench: missing completion\n");
+      exit(1);
+    }
+    if(res)
+      res[d] = r;
+    n--;
+  }
+}
+
+void
+plain(int nfiles)
+{
+  char path[8];
+  int i, fd;
+
+  for(i = 0; i < nfiles; i++){
+    name(path, i);
+    if((fd = open(path, O_CREATE|O_WRONLY)) < 0){
+      printf("ringbench: open %s failed\n", path);
+      exit(1);
+    }
+    write(fd, data, FSIZE);
+    close(fd);
+  }
+  for(i = 0; i < nfiles; i++){
+    name(path, i);
+    if((fd = open(path, O_RDONLY)) < 0){
+      printf("ringbench: open %s failed\n", path);
+      exit(1);
+    }
+    read(fd, buf[0], FSIZE);
+    close(fd);
+  }
+}
+
+// Create (or open) up to BATCH files with one trap,
+// then write or read and close all of them with a second.
+void
+ringbatch(int first, int n, int omode)
+{
+  static char paths[BATCH][8];
+  int i;
+
+  for(i = 0; i < n; i++){
+    name(paths[i], first + i);
+    ringopen(paths[i], omode, i);
+  }
+  ringsubmit();
+  reap(n, fds);
+
+  for(i = 0; i < n; i++){
+    if(fds[i] < 0){
+      printf("ringbench: ring open %s failed\n", paths[i]);
+      exit(1);
+    }
+    if(omode & O_CREATE)
+      ringwrite(fds[i], data, FSIZE, i);
+    else
+      ringread(fds[i], buf[i], FSIZE, i);
+    ringclose(fds[i], i);
+  }
+  ringsubmit();
+  reap(2*n, 0);
+}
+
+void
+ring(int nfiles)
+{
+  int i, n;
+
+  for(i = 0; i < nfiles; i += n){
+    n = nfiles - i < BATCH ? nfiles - i : BATCH;
+    ringbatch(i, n, O_CREATE|O_WRONLY);
+  }
+  for(i = 0; i < nfiles; i += n){
+    n = nfiles - i < BATCH ? nfiles - i : BATCH;
+    ringbatch(i, n, O_RDONLY);
+  }
+}
+
+void
+cleanup(int nfiles)
+{
+  char path[8];
+  int i;
+
+  for(i = 0; i < nfiles; i++){
+    name(path, i);
+    unlink(path);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nfiles = 100;
+  int t0, tplain, tring;
+
+  if(argc > 1)
+    nfiles = atoi(argv[1]);
+  if(nfiles < 1 || nfiles > 1000){
+    printf("usage: ringbench [nfiles (1-1000)]\n");
+    exit(1);
+  }
+  if(ringinit() < 0){
+    printf("ringbench: ringsetup failed\n");
+    exit(1);
+  }
+  memset(data, 'r', sizeof(data));
+
+  t0 = uptime();
+  plain(nfiles);
+  tplain = uptime() - t0;
+  cleanup(nfiles);
+
+  t0 = uptime();
+  ring(nfiles);
+  tring = uptime() - t0;
+  cleanup(nfiles);
+
+  printf("ringbench: %d files of %d bytes\n", nfiles, FSIZE);
+  printf("plain syscalls: %d ticks\n", tplain);
+  printf("syscall ring:   %d ticks\n", tring);
+  exit(0);
+}
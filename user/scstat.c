@@ -0,0 +1,45 @@
+// Print system call counters: calls, total and average
+// time, and (for the whole system) a histogram of how
+// long calls took. Times are in timer ticks (100ns on qemu).
+//
+// usage: scstat [-h] [pid]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+int
+main(int argc, char *argv[])
+{
+  struct syscallstat st;
+  int num, pid = 0, hist = 0, i, j, last;
+
+  for(i = 1; i < argc; i++){
+    if(strcmp(argv[i], "-h") == 0)
+      hist = 1;
+    else if(argv[i][0] >= '0' && argv[i][0] <= '9')
+      pid = atoi(argv[i]);
+    else {
+      fprintf(2, "usage: scstat [-h] [pid]\n");
+      exit(1);
+    }
+  }
+
+  printf("syscall calls ticks avg\n");
+  for(num = 1; syscallstat(num, pid, &st) == 0; num++){
+    if(st.count == 0)
+      continue;
+    printf("%s %l %l %l\n", st.name, st.count, st.time, st.time / st.count);
+    if(!hist || pid)
+      continue;
+    for(last = NSCHIST-1; last > 0 && st.hist[last] == 0; last--)
+      ;
+    for(j = 0; j <= last; j++)
+      printf("  <%l: %l\n", 2L << j, st.hist[j]);
+  }
+  if(num == 1){
+    fprintf(2, "scstat: no such process\n");
+    exit(1);
+  }
+  exit(0);
+}
@@ -52,6 +52,8 @@ struct backcmd {
 int fork1(void);  // Fork but panics on failure.
 void panic(char*);
 struct cmd *parsecmd(char*);
+void freecmd(struct cmd*);
+int parseerr;     // set by syntax()
 
 // Execute cmd.  Never returns.
 void
@@ -130,6 +132,81 @@ runcmd(struct cmd *cmd)
   exit(0);
 }
 
+// Can cmd run without forking the shell? Yes for a
+// command with redirections, or a pipeline of them.
+int
+simple(struct cmd *cmd)
+{
+  struct pipecmd *pcmd;
+
+  switch(cmd->type){
+  case EXEC:
+    return 1;
+  case REDIR:
+    return simple(((struct redircmd*)cmd)->cmd);
+  case PIPE:
+    pcmd = (struct pipecmd*)cmd;
+    return simple(pcmd->left) && simple(pcmd->right);
+  }
+  return 0;
+}
+
+// Start simple command cmd with spawn(), which doesn't
+// copy the shell's memory, giving it fds[0..2] as its
+// descriptors 0-2. Returns the number of processes
+// started, for the caller to wait() for.
+int
+spawncmd(struct cmd *cmd, int *fds)
+{
+  int p[2], nfds[3], fd, n;
+  struct execcmd *ecmd;
+  struct pipecmd *pcmd;
+  struct redircmd *rcmd;
+
+  memmove(nfds, fds, sizeof(nfds));
+  switch(cmd->type){
+  default:
+    panic("spawncmd");
+
+  case EXEC:
+    ecmd = (struct execcmd*)cmd;
+    if(ecmd->argv[0] == 0)
+      return 0;
+    if(spawn(ecmd->argv[0], ecmd->argv, fds, 3) < 0){
+      fprintf(2, "exec %s failed\n", ecmd->argv[0]);
+      return 0;
+    }
+    return 1;
+
+  case REDIR:
+    rcmd = (struct redircmd*)cmd;
+    if((fd = open(rcmd->file, rcmd->mode)) < 0){
+      fprintf(2, "open %s failed\n", rcmd->file);
+      return 0;
+    }
+    nfds[rcmd->fd] = fd;
+    n = spawncmd(rcmd->cmd, nfds);
+    close(fd);
+    return n;
+
+  case PIPE:
+    pcmd = (struct pipecmd*)cmd;
+    if(pipe(p) < 0){
+      fprintf(2, "pipe failed\n");
+      return 0;
+    }
+    nfds[1] = p[1];
+    n = spawncmd(pcmd->left, nfds);
+    nfds[0] = p[0];
+    nfds[1] = fds[1];
+    n += spawncmd(pcmd->right, nfds);
+    close(p[0]);
+    close(p[1]);
+    return n;
+  }
+  return 0;
+}
+
 int
 getcmd(char *buf, int nbuf)
 {
@@ -145,7 +222,9 @@ int
 main(void)
 {
   static char buf[100];
-  int fd;
+  static int fds[3] = { 0, 1, 2 };
+  struct cmd *cmd;
+  int fd, n;
 
   // Ensure that three file descriptors are open.
   while((fd = open("console", O_RDWR)) >= 0){
@@ -164,9 +243,21 @@ main(void)
         fprintf(2, "cannot cd %s\n", buf+3);
       continue;
     }
-    if(fork1() == 0)
-      runcmd(parsecmd(buf));
-    wait(0);
+    parseerr = 0;
+    cmd = parsecmd(buf);
+    if(parseerr){
+      freecmd(cmd);
+      continue;
+    }
+    if(simple(cmd)){
+      for(n = spawncmd(cmd, fds); n > 0; n--)
+        wait(0);
+    } else {
+      if(fork1() == 0)
+        runcmd(cmd);
+      wait(0);
+    }
+    freecmd(cmd);
   }
   exit(0);
 }
@@ -259,6 +350,16 @@ backcmd(struct cmd *subcmd)
 //PAGEBREAK!
 // Parsing
 
+// The shell parses commands itself, so a syntax
+// error must not exit; report only the first.
+void
+syntax(char *msg)
+{
+  if(!parseerr)
+    fprintf(2, "%s\n", msg);
+  parseerr = 1;
+}
+
 char whitespace[] = " \t\r\n\v";
 char symbols[] = "<|>&;()";
 
@@ -333,9 +434,9 @@ parsecmd(char *s)
   es = s + strlen(s);
   cmd = parseline(&s, es);
   peek(&s, es, "");
-  if(s != es){
+  if(s != es && !parseerr){
     fprintf(2, "leftovers: %s\n", s);
-    panic("syntax");
+    syntax("syntax");
   }
   nulterminate(cmd);
   return cmd;
@@ -379,8 +480,10 @@ parseredirs(struct cmd *cmd, char **ps, char *es)
 
   while(peek(ps, es, "<>")){
     tok = gettoken(ps, es, 0, 0);
-    if(gettoken(ps, es, &q, &eq) != 'a')
-      panic("missing file for redirection");
+    if(gettoken(ps, es, &q, &eq) != 'a'){
+      syntax("missing file for redirection");
+      break;
+    }
     switch(tok){
     case '<':
       cmd = redircmd(cmd, q, eq, O_RDONLY, 0);
@@ -405,8 +508,10 @@ parseblock(char **ps, char *es)
     panic("parseblock");
   gettoken(ps, es, 0, 0);
   cmd = parseline(ps, es);
-  if(!peek(ps, es, ")"))
-    panic("syntax - missing )");
+  if(!peek(ps, es, ")")){
+    syntax("syntax - missing )");
+    return cmd;
+  }
   gettoken(ps, es, 0, 0);
   cmd = parseredirs(cmd, ps, es);
   return cmd;
@@ -431,13 +536,17 @@ parseexec(char **ps, char *es)
   while(!peek(ps, es, "|)&;")){
     if((tok=gettoken(ps, es, &q, &eq)) == 0)
       break;
-    if(tok != 'a')
-      panic("syntax");
+    if(tok != 'a'){
+      syntax("syntax");
+      break;
+    }
+    if(argc >= MAXARGS-1){
+      syntax("too many args");
+      break;
+    }
     cmd->argv[argc] = q;
     cmd->eargv[argc] = eq;
     argc++;
-    if(argc >= MAXARGS)
-      panic("too many args");
     ret = parseredirs(ret, ps, es);
   }
   cmd->argv[argc] = 0;
@@ -491,3 +600,32 @@ nulterminate(struct cmd *cmd)
   }
   return cmd;
 }
+
+// Free cmd and everything it points to.
+void
+freecmd(struct cmd *cmd)
+{
+  if(cmd == 0)
+    return;
+
+  switch(cmd->type){
+  case REDIR:
+    freecmd(((struct redircmd*)cmd)->cmd);
+    break;
+
+  case PIPE:
+    freecmd(((struct pipecmd*)cmd)->left);
+    freecmd(((struct pipecmd*)cmd)->right);
+    break;
+
+  case LIST:
+    freecmd(((struct listcmd*)cmd)->left);
+    freecmd(((struct listcmd*)cmd)->right);
+    break;
+
+  case BACK:
+    freecmd(((struct backcmd*)cmd)->cmd);
+    break;
+  }
+  free(cmd);
+}
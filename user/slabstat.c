@@ -0,0 +1,32 @@
+// Print the kernel's object cache statistics.
+//
+// usage: slabstat
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define N 24
+
+struct slabstat st[N];
+
+int
+main(void)
+{
+  int n, i, j;
+
+  if((n = slabstat(st, N)) < 0){
+    fprintf(2, "slabstat: slabstat failed\n");
+    exit(1);
+  }
+
+  printf("name             size perslab slabs inuse cached allocs refills\n");
+  for(i = 0; i < n; i++){
+    printf("%s", st[i].name);
+    for(j = strlen(st[i].name); j < SLABNAME + 1; j++)
+      printf(" ");
+    printf("%d %d %d %l %d %l %l\n", st[i].size, st[i].perslab, st[i].nslab,
+           st[i].nalloc - st[i].nfree, st[i].ncached, st[i].nalloc, st[i].nrefill);
+  }
+  exit(0);
+}
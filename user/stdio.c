@@ -0,0 +1,175 @@
+// Buffered I/O on file descriptors.
+//
+// Output to fd 1 collects in a buffer and is written when the
+// buffer fills or, if fd 1 is a terminal (T_DEVICE), at each
+// newline. Output to any other fd (2, most often) is written
+// with one write() per printf(). fflush() writes out what is
+// buffered; exit(), fork(), exec(), and close() flush first
+// (see flushhook in ulib.c).
+//
+// getc() and fgets() read fd 0 through a buffer too, but only
+// if it's a terminal, whose read()s end at a newline. Anything
+// else is read a byte at a time, so that a program reading
+// commands from fd 0 (sh < script) leaves the rest of the input
+// where the commands it runs can read it.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define BUFSZ 512
+
+enum { UNKNOWN, UNBUF, LINEBUF, FULLBUF };
+
+struct ostream {
+  int fd;        // -1 if none
+  int mode;
+  int n;         // bytes waiting in buf
+  char buf[BUFSZ];
+};
+
+// stdout, and one for whichever other fd printf() is writing.
+static struct ostream out = { 1 };
+static struct ostream other = { -1, UNBUF };
+
+// fd 0 input.
+static struct {
+  int mode;      // LINEBUF or UNBUF, once known
+  int n;         // bytes in buf
+  int off;       // next byte to return
+  char buf[BUFSZ];
+} in;
+
+static void flushfd(int fd);
+
+static void
+writeout(struct ostream *s)
+{
+  char *p = s->buf;
+  int n;
+
+  // give up on what can't be written, as write() would.
+  while(s->n > 0 && (n = write(s->fd, p, s->n)) > 0){
+    p += n;
+    s->n -= n;
+  }
+  s->n = 0;
+}
+
+void
+fputc(int fd, char c)
+{
+  struct ostream *s;
+  struct stat st;
+
+  if(fd == 1){
+    s = &out;
+  } else {
+    s = &other;
+    if(s->fd != fd){
+      writeout(s);
+      s->fd = fd;
+    }
+  }
+  if(s->mode == UNKNOWN){
+    flushhook = flushfd;
+    s->mode = FULLBUF;
+    if(fstat(fd, &st) == 0 && st.type == T_DEVICE)
+      s->mode = LINEBUF;
+  }
+
+  s->buf[s->n++] = c;
+  if(s->n == BUFSZ || (s->mode == LINEBUF && c == '\n'))
+    writeout(s);
+}
+
+// The end of one printf() to fd: write it now
+// if fd isn't buffered.
+void
+fdone(int fd)
+{
+  if(fd != 1)
+    writeout(&other);
+}
+
+// Write out anything buffered for fd.
+void
+fflush(int fd)
+{
+  if(fd == 1)
+    writeout(&out);
+  else if(fd == other.fd)
+    writeout(&other);
+}
+
+// Called by exit() &c with fd -1, and by close(fd).
+static void
+flushfd(int fd)
+{
+  if(fd == -1 || fd == 1){
+    writeout(&out);
+    if(fd == 1)
+      out.mode = UNKNOWN;   // fd 1 may be reopened as something else
+  }
+  if(fd == -1 || fd == other.fd)
+    writeout(&other);
+  if(fd == 0){
+    in.n = in.off = 0;
+    in.mode = UNKNOWN;      // fd 0 may be reopened too
+  }
+}
+
+// Read one byte. Returns it, or -1 at end of file or on error.
+int
+getc(int fd)
+{
+  uchar c;
+  struct stat st;
+
+  if(fd != 0)
+    return read(fd, &c, 1) == 1 ? c : -1;
+
+  if(in.off == in.n){
+    // what's waiting for input ought to be visible first.
+    flushhook = flushfd;
+    writeout(&out);
+    if(in.mode == UNKNOWN){
+      in.mode = UNBUF;
+      if(fstat(0, &st) == 0 && st.type == T_DEVICE)
+        in.mode = LINEBUF;
+    }
+    if(in.mode == UNBUF)
+      return read(0, &c, 1) == 1 ? c : -1;
+    in.off = 0;
+    if((in.n = read(0, in.buf, sizeof(in.buf))) <= 0){
+      in.n = 0;
+      return -1;
+    }
+  }
+  return (uchar)in.buf[in.off++];
+}
+
+// Read a line, including its newline, of up to max-1 bytes
+// into buf and NUL-terminate it. Returns buf, with buf[0] == 0
+// at end of file.
+char*
+fgets(int fd, char *buf, int max)
+{
+  int i, c;
+
+  for(i=0; i+1 < max; ){
+    if((c = getc(fd)) < 0)
+      break;
+    buf[i++] = c;
+    if(c == '\n' || c == '\r')
+      break;
+  }
+  buf[i] = '\0';
+  return buf;
+}
+
+char*
+gets(char *buf, int max)
+{
+  return fgets(0, buf, max);
+}
@@ -3,6 +3,65 @@
 #include "kernel/fcntl.h"
 #include "user/user.h"
 
+// the system calls themselves; see usys.pl.
+int _fork(void);
+int _exit(int) __attribute__((noreturn));
+int _close(int);
+int _exec(char*, char**);
+int _spawn(char*, char**, int*, int);
+
+// If set, called to flush buffered output (see stdio.c)
+// for fd, or for every fd if fd is -1.
+void (*flushhook)(int);
+
+int
+fork(void)
+{
+  if(flushhook)
+    flushhook(-1);
+  return _fork();
+}
+
+int
+exit(int status)
+{
+  if(flushhook)
+    flushhook(-1);
+  _exit(status);
+}
+
+int
+close(int fd)
+{
+  if(flushhook)
+    flushhook(fd);
+  return _close(fd);
+}
+
+int
+exec(char *path, char **argv)
+{
+  if(flushhook)
+    flushhook(-1);
+  return _exec(path, argv);
+}
+
+int
+spawn(char *path, char **argv, int *fds, int nfd)
+{
+  if(flushhook)
+    flushhook(-1);
+  return _spawn(path, argv, fds, nfd);
+}
+
+// memset(), memmove(), and memcmp() work a word at a time
+// where they can, like their kernel/string.c counterparts.
+
+#define WSIZE sizeof(uint64)
+
+#define ALIGNED(p) (((uint64)(p) & (WSIZE-1)) == 0)
+#define COALIGNED(p, q) ((((uint64)(p) ^ (uint64)(q)) & (WSIZE-1)) == 0)
+
 char*
 strcpy(char *s, const char *t)
 {
@@ -35,11 +94,27 @@ strlen(const char *s)
 void*
 memset(void *dst, int c, uint n)
 {
-  char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  uchar *d = dst;
+  uint64 w, *wd;
+
+  for(; n > 0 && !ALIGNED(d); n--)
+    *d++ = c;
+
+  w = (uchar)c;
+  w |= w << 8;
+  w |= w << 16;
+  w |= w << 32;
+  wd = (uint64*)d;
+  for(; n >= 8*WSIZE; n -= 8*WSIZE, wd += 8){
+    wd[0] = w; wd[1] = w; wd[2] = w; wd[3] = w;
+    wd[4] = w; wd[5] = w; wd[6] = w; wd[7] = w;
   }
+  for(; n >= WSIZE; n -= WSIZE)
+    *wd++ = w;
+
+  d = (uchar*)wd;
+  while(n-- > 0)
+    *d++ = c;
   return dst;
 }
 
@@ -52,24 +127,6 @@ strchr(const char *s, char c)
   return 0;
 }
 
-char*
-gets(char *buf, int max)
-{
-  int i, cc;
-  char c;
-
-  for(i=0; i+1 < max; ){
-    cc = read(0, &c, 1);
-    if(cc < 1)
-      break;
-    buf[i++] = c;
-    if(c == '\n' || c == '\r')
-      break;
-  }
-  buf[i] = '\0';
-  return buf;
-}
-
 int
 stat(const char *n, struct stat *st)
 {
@@ -100,15 +157,49 @@ memmove(void *vdst, const void *vsrc, int n)
 {
   char *dst;
   const char *src;
+  uint64 *wd, w0, w1, w2, w3, w4, w5, w6, w7;
+  const uint64 *ws;
 
+  // n is signed, and WSIZE isn't: a negative n would
+  // pass the n >= WSIZE tests below.
+  if(n <= 0)
+    return vdst;
   dst = vdst;
   src = vsrc;
   if (src > dst) {
+    if(COALIGNED(src, dst)){
+      for(; n > 0 && !ALIGNED(dst); n--)
+        *dst++ = *src++;
+      ws = (const uint64*)src;
+      wd = (uint64*)dst;
+      // load all eight words before storing any, in case
+      // dst is just below src.
+      for(; n >= 8*WSIZE; n -= 8*WSIZE, ws += 8, wd += 8){
+        w0 = ws[0]; w1 = ws[1]; w2 = ws[2]; w3 = ws[3];
+        w4 = ws[4]; w5 = ws[5]; w6 = ws[6]; w7 = ws[7];
+        wd[0] = w0; wd[1] = w1; wd[2] = w2; wd[3] = w3;
+        wd[4] = w4; wd[5] = w5; wd[6] = w6; wd[7] = w7;
+      }
+      for(; n >= WSIZE; n -= WSIZE)
+        *wd++ = *ws++;
+      src = (const char*)ws;
+      dst = (char*)wd;
+    }
     while(n-- > 0)
       *dst++ = *src++;
   } else {
     dst += n;
     src += n;
+    if(COALIGNED(src, dst)){
+      for(; n > 0 && !ALIGNED(dst); n--)
+        *--dst = *--src;
+      ws = (const uint64*)src;
+      wd = (uint64*)dst;
+      for(; n >= WSIZE; n -= WSIZE)
+        *--wd = *--ws;
+      src = (const char*)ws;
+      dst = (char*)wd;
+    }
     while(n-- > 0)
       *--dst = *--src;
   }
@@ -119,6 +210,18 @@ int
 memcmp(const void *s1, const void *s2, uint n)
 {
   const char *p1 = s1, *p2 = s2;
+
+  if(COALIGNED(p1, p2)){
+    for(; n > 0 && !ALIGNED(p1); n--, p1++, p2++){
+      if(*p1 != *p2)
+        return *p1 - *p2;
+    }
+    // skip equal words; the byte loop finds the difference.
+    for(; n >= WSIZE && *(uint64*)p1 == *(uint64*)p2; n -= WSIZE){
+      p1 += WSIZE;
+      p2 += WSIZE;
+    }
+  }
   while (n-- > 0) {
     if (*p1 != *p2) {
       return *p1 - *p2;
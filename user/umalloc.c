@@ -3,88 +3,237 @@
 #include "user/user.h"
 #include "kernel/param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator with size classes.
+//
+// Every block starts with a header holding its size, header
+// included. A small block (up to MAXSMALL bytes) has one of a
+// few fixed sizes, and a free one sits on a LIFO list for its
+// size, so malloc() and free() of small blocks take constant
+// time. Small blocks are carved from arenas of ARENA bytes
+// got with sbrk(), and are never given back.
+//
+// A large block comes straight from sbrk(), and a free one
+// goes on a list, sorted by address, where it merges with its
+// free neighbours. A free block that ends at the top of the
+// heap is given back to the kernel by shrinking sbrk().
 
 typedef long Align;
 
 union header {
   struct {
-    union header *ptr;
-    uint size;
+    uint64 size;            // bytes, header included
+    union header *next;     // on a free list; not in a used block
   } s;
   Align x;
 };
 
 typedef union header Header;
 
-static Header base;
-static Header *freep;
+#define HDR sizeof(uint64)  // bytes a used block gives the header
+#define MAXSMALL 1024
+#define ARENA (16*4096)
+#define LARGEUNIT 64        // large blocks are multiples of this
+
+static uint classes[] = {
+  16, 32, 48, 64, 80, 96, 112, 128,
+  192, 256, 384, 512, 768, MAXSMALL,
+};
+#define NCLASS (sizeof(classes)/sizeof(classes[0]))
+
+static Header *smallfree[NCLASS];
+static char *arena, *arenaend;    // unused part of the current arena
+static Header *largefree;         // sorted by address
+
+// Grow the heap by n bytes, starting at a multiple of
+// sizeof(Header) even if someone else has called sbrk().
+// Returns 0 if out of memory.
+static char*
+morecore(uint64 n)
+{
+  uint64 pad = -(uint64)sbrk(0) % sizeof(Header);
+  char *a;
+
+  if(n + pad > 0x7fffffff || (a = sbrk(n + pad)) == (char*)-1)
+    return 0;
+  return a + pad;
+}
+
+// The size class of a small block of n bytes.
+static int
+sizeclass(uint64 n)
+{
+  int i;
+
+  for(i = 0; classes[i] < n; i++)
+    ;
+  return i;
+}
+
+static void*
+smallalloc(uint64 n)
+{
+  Header *p;
+  char *a;
+  int c;
+
+  c = sizeclass(n);
+  if((p = smallfree[c]) != 0){
+    smallfree[c] = p->s.next;
+    return (char*)p + HDR;
+  }
+  if(arenaend - arena < classes[c]){
+    if((a = morecore(ARENA)) == 0)
+      return 0;
+    arena = a;
+    arenaend = a + ARENA;
+  }
+  p = (Header*)arena;
+  arena += classes[c];
+  p->s.size = classes[c];
+  return (char*)p + HDR;
+}
+
+// Give free large block b back to the kernel
+// if it's at the top of the heap.
+static void
+trimtop(Header *b)
+{
+  Header **pp;
+
+  if((char*)b + b->s.size != sbrk(0))
+    return;
+  for(pp = &largefree; *pp != b; pp = &(*pp)->s.next)
+    ;
+  *pp = b->s.next;
+  sbrk(-(int)b->s.size);
+}
+
+// Put large block b on the free list, merging
+// it with its free neighbours.
+static void
+largefreeblock(Header *b)
+{
+  Header *p, *prev;
+
+  prev = 0;
+  for(p = largefree; p && p < b; p = p->s.next)
+    prev = p;
+  b->s.next = p;
+  if(p && (char*)b + b->s.size == (char*)p){
+    b->s.size += p->s.size;
+    b->s.next = p->s.next;
+  }
+  if(prev && (char*)prev + prev->s.size == (char*)b){
+    prev->s.size += b->s.size;
+    prev->s.next = b->s.next;
+    b = prev;
+  } else if(prev){
+    prev->s.next = b;
+  } else {
+    largefree = b;
+  }
+  trimtop(b);
+}
+
+static void*
+largealloc(uint64 n)
+{
+  Header *p, **pp, *rest;
+  char *a;
+
+  n = (n + LARGEUNIT - 1) & ~(LARGEUNIT - 1);
+  // first fit.
+  for(pp = &largefree; (p = *pp) != 0; pp = &p->s.next){
+    if(p->s.size < n)
+      continue;
+    if(p->s.size - n > MAXSMALL){
+      rest = (Header*)((char*)p + n);
+      rest->s.size = p->s.size - n;
+      rest->s.next = p->s.next;
+      *pp = rest;
+      p->s.size = n;
+    } else {
+      *pp = p->s.next;
+    }
+    return (char*)p + HDR;
+  }
+  if((a = morecore(n)) == 0)
+    return 0;
+  p = (Header*)a;
+  p->s.size = n;
+  return (char*)p + HDR;
+}
 
 void
 free(void *ap)
 {
-  Header *bp, *p;
-
-  bp = (Header*)ap - 1;
-  for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
-    if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
-      break;
-  if(bp + bp->s.size == p->s.ptr){
-    bp->s.size += p->s.ptr->s.size;
-    bp->s.ptr = p->s.ptr->s.ptr;
-  } else
-    bp->s.ptr = p->s.ptr;
-  if(p + p->s.size == bp){
-    p->s.size += bp->s.size;
-    p->s.ptr = bp->s.ptr;
-  } else
-    p->s.ptr = bp;
-  freep = p;
+  Header *p;
+
+  if(ap == 0)
+    return;
+  p = (Header*)((char*)ap - HDR);
+  if(p->s.size <= MAXSMALL){
+    int c = sizeclass(p->s.size);
+    p->s.next = smallfree[c];
+    smallfree[c] = p;
+  } else {
+    largefreeblock(p);
+  }
 }
 
-static Header*
-morecore(uint nu)
+void*
+malloc(uint nbytes)
 {
-  char *p;
-  Header *hp;
+  uint64 n = (uint64)nbytes + HDR;
 
-  if(nu < 4096)
-    nu = 4096;
-  p = sbrk(nu * sizeof(Header));
-  if(p == (char*)-1)
+  // a free block must have room for s.next.
+  if(n < sizeof(Header))
+    n = sizeof(Header);
+  if(n <= MAXSMALL)
+    return smallalloc(n);
+  return largealloc(n);
+}
+
+void*
+calloc(uint nmemb, uint size)
+{
+  uint64 n = (uint64)nmemb * size;
+  void *p;
+
+  if(n > 0xffffffff || (p = malloc(n)) == 0)
     return 0;
-  hp = (Header*)p;
-  hp->s.size = nu;
-  free((void*)(hp + 1));
-  return freep;
+  memset(p, 0, n);
+  return p;
 }
 
 void*
-malloc(uint nbytes)
+realloc(void *ap, uint nbytes)
 {
-  Header *p, *prevp;
-  uint nunits;
+  Header *p;
+  uint64 n = (uint64)nbytes + HDR;
+  uint64 more;
+  void *np;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
-  if((prevp = freep) == 0){
-    base.s.ptr = freep = prevp = &base;
-    base.s.size = 0;
+  if(ap == 0)
+    return malloc(nbytes);
+  if(nbytes == 0){
+    free(ap);
+    return 0;
   }
-  for(p = prevp->s.ptr; ; prevp = p, p = p->s.ptr){
-    if(p->s.size >= nunits){
-      if(p->s.size == nunits)
-        prevp->s.ptr = p->s.ptr;
-      else {
-        p->s.size -= nunits;
-        p += p->s.size;
-        p->s.size = nunits;
-      }
-      freep = prevp;
-      return (void*)(p + 1);
+  p = (Header*)((char*)ap - HDR);
+  if(n <= p->s.size)
+    return ap;
+  // a large block at the top of the heap can grow in place.
+  if(p->s.size > MAXSMALL && (char*)p + p->s.size == sbrk(0)){
+    more = ((n - p->s.size) + LARGEUNIT - 1) & ~(LARGEUNIT - 1);
+    if(more <= 0x7fffffff && sbrk(more) != (char*)-1){
+      p->s.size += more;
+      return ap;
     }
-    if(p == freep)
-      if((p = morecore(nunits)) == 0)
-        return 0;
   }
+  if((np = malloc(nbytes)) == 0)
+    return 0;
+  memmove(np, ap, p->s.size - HDR);
+  free(ap);
+  return np;
 }
@@ -1,5 +1,12 @@
 struct stat;
 struct rtcdate;
+struct ring;
+struct dcachestat;
+struct lockstat;
+struct profsample;
+struct syscallstat;
+struct slabstat;
+struct memstat;
 
 // system calls
 int fork(void);
@@ -23,6 +30,17 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+struct ring* ringsetup(void);
+int ringenter(int);
+int dcachestat(struct dcachestat*);
+int lockstat(struct lockstat*, int);
+int mount(char*, char*);
+int prof(int, struct profsample*, int);
+int syscallstat(int, int, struct syscallstat*);
+int slabstat(struct slabstat*, int);
+int memstat(struct memstat*);
+int spawn(char*, char**, int*, int);
+int waitpid(int, int*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -32,11 +50,30 @@ char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
 void fprintf(int, const char*, ...);
 void printf(const char*, ...);
-char* gets(char*, int max);
 uint strlen(const char*);
 void* memset(void*, int, uint);
 void* malloc(uint);
 void free(void*);
+void* calloc(uint, uint);
+void* realloc(void*, uint);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+extern void (*flushhook)(int);
+
+// stdio.c
+void fputc(int, char);
+void fdone(int);
+void fflush(int);
+int getc(int);
+char* fgets(int, char*, int max);
+char* gets(char*, int max);
+
+// ring.c
+int ringinit(void);
+int ringread(int, void*, int, uint64);
+int ringwrite(int, const void*, int, uint64);
+int ringopen(const char*, int, uint64);
+int ringclose(int, uint64);
+int ringsubmit(void);
+int ringreap(uint64*, int*);
@@ -4,7 +4,9 @@
 #include "user/user.h"
 #include "kernel/fs.h"
 #include "kernel/fcntl.h"
+#include "kernel/wait.h"
 #include "kernel/syscall.h"
+#include "kernel/prof.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
 
@@ -669,6 +671,51 @@ void dirtest(char *s)
   }
 }
 
+// on the default file system new directories are hashed:
+// mkdir, chdir, and unlink must work in them, including
+// after enough names to split a block.
+void
+hashdir(char *s)
+{
+  enum { N = 150 };
+  char name[8];
+  int i, fd;
+
+  if(mkdir("hd0") < 0 || chdir("hd0") < 0){
+    printf("%s: mkdir/chdir hd0 failed\n", s);
+    exit(1);
+  }
+  if(mkdir("sub") < 0 || chdir("sub") < 0 || chdir("..") < 0){
+    printf("%s: mkdir/chdir sub failed\n", s);
+    exit(1);
+  }
+  name[0] = 'f';
+  name[4] = 0;
+  for(i = 0; i < N; i++){
+    name[1] = '0' + i / 100;
+    name[2] = '0' + (i / 10) % 10;
+    name[3] = '0' + i % 10;
+    if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+      printf("%s: create %s failed\n", s, name);
+      exit(1);
+    }
+    close(fd);
+  }
+  for(i = 0; i < N; i++){
+    name[1] = '0' + i / 100;
+    name[2] = '0' + (i / 10) % 10;
+    name[3] = '0' + i % 10;
+    if(unlink(name) < 0){
+      printf("%s: unlink %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  if(unlink("sub") < 0 || chdir("..") < 0 || unlink("hd0") < 0){
+    printf("%s: cleanup failed\n", s);
+    exit(1);
+  }
+}
+
 void
 exectest(char *s)
 {
@@ -724,6 +771,164 @@ exectest(char *s)
 
 }
 
+// spawn() must start the program with its arguments and
+// exactly the descriptors it was given: if the child kept
+// the pipe's read end, or anything else, this wouldn't
+// see end of file.
+void
+spawntest(char *s)
+{
+  char *echoargv[] = { "echo", "spawn", "ok", 0 };
+  char *noargv[] = { "nonexistent", 0 };
+  int fds[3], p[2], pid, n, tot, xstatus;
+  char buf[32];
+
+  if(pipe(p) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  fds[0] = -1;
+  fds[1] = p[1];
+  fds[2] = 2;
+  if((pid = spawn("echo", echoargv, fds, 3)) < 0){
+    printf("%s: spawn failed\n", s);
+    exit(1);
+  }
+  close(p[1]);
+  tot = 0;
+  while((n = read(p[0], buf + tot, sizeof(buf) - 1 - tot)) > 0)
+    tot += n;
+  close(p[0]);
+  buf[tot] = 0;
+  if(wait(&xstatus) != pid || xstatus != 0){
+    printf("%s: wait failed\n", s);
+    exit(1);
+  }
+  if(strcmp(buf, "spawn ok\n") != 0){
+    printf("%s: wrong output %s\n", s, buf);
+    exit(1);
+  }
+
+  if(spawn("nonexistent", noargv, 0, 0) >= 0){
+    printf("%s: spawned nonexistent\n", s);
+    exit(1);
+  }
+  fds[0] = 99;
+  if(spawn("echo", echoargv, fds, 3) >= 0){
+    printf("%s: spawned with a bad fd\n", s);
+    exit(1);
+  }
+}
+
+// waitpid() must wait for just the child it's asked about,
+// and not at all with WNOHANG.
+void
+waitpidtest(char *s)
+{
+  int pids[3], fds[2], i, pid, xstatus;
+  char c;
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 3; i++){
+    if((pids[i] = fork()) < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pids[i] == 0){
+      // the last child waits until the pipe is closed.
+      close(fds[1]);
+      if(i == 2)
+        read(fds[0], &c, 1);
+      exit(10 + i);
+    }
+  }
+  close(fds[0]);
+
+  if(waitpid(pids[1], &xstatus, 0) != pids[1] || xstatus != 11){
+    printf("%s: waitpid(middle child) failed\n", s);
+    exit(1);
+  }
+  if(waitpid(pids[1], 0, 0) != -1){
+    printf("%s: waitpid found a freed child\n", s);
+    exit(1);
+  }
+  if(waitpid(pids[2], &xstatus, WNOHANG) != 0){
+    printf("%s: WNOHANG didn't return 0\n", s);
+    exit(1);
+  }
+  if(waitpid(getpid(), 0, WNOHANG) != -1){
+    printf("%s: waitpid on a non-child\n", s);
+    exit(1);
+  }
+  close(fds[1]);
+  if(waitpid(pids[2], &xstatus, 0) != pids[2] || xstatus != 12){
+    printf("%s: waitpid(last child) failed\n", s);
+    exit(1);
+  }
+  if((pid = wait(&xstatus)) != pids[0] || xstatus != 10){
+    printf("%s: wait got %d\n", s, pid);
+    exit(1);
+  }
+  if(wait(0) != -1){
+    printf("%s: too many children\n", s);
+    exit(1);
+  }
+}
+
+// sh reading commands from a file must leave the lines
+// after each command for the command to read.
+void
+shstdin(char *s)
+{
+  char *argv[] = { "sh", 0 };
+  char *script = "cat\nhello\n";
+  char buf[32];
+  int fd, fds[2], pid, n, m, xstatus;
+
+  fd = open("shstdin", O_CREATE|O_WRONLY);
+  if(fd < 0 || write(fd, script, strlen(script)) != strlen(script)){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(0);
+    if(open("shstdin", O_RDONLY) != 0)
+      exit(1);
+    close(1);
+    dup(fds[1]);
+    close(fds[0]);
+    close(fds[1]);
+    close(2);  // no prompts
+    exec("sh", argv);
+    exit(1);
+  }
+  close(fds[1]);
+  n = 0;
+  while(n < sizeof(buf) - 1 && (m = read(fds[0], buf + n, sizeof(buf) - 1 - n)) > 0)
+    n += m;
+  buf[n] = 0;
+  close(fds[0]);
+  wait(&xstatus);
+  unlink("shstdin");
+  if(strcmp(buf, "hello\n") != 0){
+    printf("%s: cat read \"%s\"\n", s, buf);
+    exit(1);
+  }
+}
+
 // simple fork and pipe read/write
 
 void
@@ -1080,6 +1285,58 @@ mem(char *s)
   }
 }
 
+// realloc() must keep the contents, calloc() must zero,
+// and freeing a big block at the top of the heap must
+// give the memory back.
+void
+malloctest(char *s)
+{
+  char *top, *p, *q;
+  int i;
+
+  p = malloc(100);
+  for(i = 0; i < 100; i++)
+    p[i] = i;
+  p = realloc(p, 5000);
+  q = realloc(malloc(10), 20);
+  if(p == 0 || q == 0){
+    printf("%s: realloc failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 100; i++){
+    if(p[i] != i){
+      printf("%s: realloc lost data\n", s);
+      exit(1);
+    }
+  }
+  free(p);
+  free(q);
+
+  p = malloc(64*1024);
+  memset(p, 'x', 64*1024);
+  free(p);
+  p = calloc(64, 1024);
+  for(i = 0; i < 64*1024; i++){
+    if(p[i] != 0){
+      printf("%s: calloc didn't zero\n", s);
+      exit(1);
+    }
+  }
+  free(p);
+
+  top = sbrk(0);
+  p = malloc(1024*1024);
+  if(p == 0 || sbrk(0) < top + 1024*1024){
+    printf("%s: malloc didn't grow the heap\n", s);
+    exit(1);
+  }
+  free(p);
+  if(sbrk(0) != top){
+    printf("%s: free didn't shrink the heap\n", s);
+    exit(1);
+  }
+}
+
 // More file system tests
 
 // two processes write to the same file descriptor
@@ -1553,6 +1810,92 @@ bigdir(char *s)
   }
 }
 
+// a directory with enough entries to split its blocks many
+// times must still find every name, and must read back as
+// dirents holding exactly the names that are left.
+void
+manyfiles(char *s)
+{
+  enum { N = 1000 };
+  char name[32];
+  struct dirent de;
+  int i, fd, n;
+
+  unlink("mfd");
+  if(mkdir("mfd") < 0){
+    printf("%s: mkdir mfd failed\n", s);
+    exit(1);
+  }
+  strcpy(name, "mfd/a-rather-long-name-");
+  for(i = 0; i < N; i++){
+    name[23] = 'a' + i / 100;
+    name[24] = '0' + (i / 10) % 10;
+    name[25] = '0' + i % 10;
+    name[26] = 0;
+    if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+      printf("%s: create %s failed\n", s, name);
+      exit(1);
+    }
+    close(fd);
+  }
+  for(i = 0; i < N; i += 2){
+    name[23] = 'a' + i / 100;
+    name[24] = '0' + (i / 10) % 10;
+    name[25] = '0' + i % 10;
+    if(unlink(name) < 0){
+      printf("%s: unlink %s failed\n", s, name);
+      exit(1);
+    }
+  }
+  for(i = 0; i < N; i++){
+    name[23] = 'a' + i / 100;
+    name[24] = '0' + (i / 10) % 10;
+    name[25] = '0' + i % 10;
+    fd = open(name, O_RDONLY);
+    if((i % 2 == 0) != (fd < 0)){
+      printf("%s: open %s returned %d\n", s, name, fd);
+      exit(1);
+    }
+    if(fd >= 0)
+      close(fd);
+  }
+
+  if((fd = open("mfd", O_RDONLY)) < 0){
+    printf("%s: open mfd failed\n", s);
+    exit(1);
+  }
+  n = 0;
+  while(read(fd, &de, sizeof(de)) == sizeof(de)){
+    if(de.inum == 0 || strcmp(de.name, ".") == 0 || strcmp(de.name, "..") == 0)
+      continue;
+    if(strlen(de.name) != 22 || (de.name[21] - '0') % 2 != 1){
+      printf("%s: unexpected name %s in mfd\n", s, de.name);
+      exit(1);
+    }
+    n++;
+  }
+  close(fd);
+  if(n != N/2){
+    printf("%s: read %d names from mfd, not %d\n", s, n, N/2);
+    exit(1);
+  }
+
+  if(unlink("mfd") == 0){
+    printf("%s: unlinked non-empty mfd\n", s);
+    exit(1);
+  }
+  for(i = 1; i < N; i += 2){
+    name[23] = 'a' + i / 100;
+    name[24] = '0' + (i / 10) % 10;
+    name[25] = '0' + i % 10;
+    unlink(name);
+  }
+  if(unlink("mfd") < 0){
+    printf("%s: unlink mfd failed\n", s);
+    exit(1);
+  }
+}
+
 void
 subdir(char *s)
 {
@@ -1866,49 +2209,49 @@ bigfile(char *s)
 }
 
 void
-fourteen(char *s)
+thirty(char *s)
 {
   int fd;
 
-  // DIRSIZ is 14.
+  // DIRSIZ is 30.
 
-  if(mkdir("12345678901234") != 0){
-    printf("%s: mkdir 12345678901234 failed\n", s);
+  if(mkdir("123456789012345678901234567890") != 0){
+    printf("%s: mkdir 123456789012345678901234567890 failed\n", s);
     exit(1);
   }
-  if(mkdir("12345678901234/123456789012345") != 0){
-    printf("%s: mkdir 12345678901234/123456789012345 failed\n", s);
+  if(mkdir("123456789012345678901234567890/1234567890123456789012345678901") != 0){
+    printf("%s: mkdir 123456789012345678901234567890/1234567890123456789012345678901 failed\n", s);
     exit(1);
   }
-  fd = open("123456789012345/123456789012345/123456789012345", O_CREATE);
+  fd = open("1234567890123456789012345678901/1234567890123456789012345678901/1234567890123456789012345678901", O_CREATE);
   if(fd < 0){
-    printf("%s: create 123456789012345/123456789012345/123456789012345 failed\n", s);
+    printf("%s: create 1234567890123456789012345678901/1234567890123456789012345678901/1234567890123456789012345678901 failed\n", s);
     exit(1);
   }
   close(fd);
-  fd = open("12345678901234/12345678901234/12345678901234", 0);
+  fd = open("123456789012345678901234567890/123456789012345678901234567890/123456789012345678901234567890", 0);
   if(fd < 0){
-    printf("%s: open 12345678901234/12345678901234/12345678901234 failed\n", s);
+    printf("%s: open 123456789012345678901234567890/123456789012345678901234567890/123456789012345678901234567890 failed\n", s);
     exit(1);
   }
   close(fd);
 
-  if(mkdir("12345678901234/12345678901234") == 0){
-    printf("%s: mkdir 12345678901234/12345678901234 succeeded!\n", s);
+  if(mkdir("123456789012345678901234567890/123456789012345678901234567890") == 0){
+    printf("%s: mkdir 123456789012345678901234567890/123456789012345678901234567890 succeeded!\n", s);
     exit(1);
   }
-  if(mkdir("123456789012345/12345678901234") == 0){
-    printf("%s: mkdir 12345678901234/123456789012345 succeeded!\n", s);
+  if(mkdir("1234567890123456789012345678901/123456789012345678901234567890") == 0){
+    printf("%s: mkdir 123456789012345678901234567890/1234567890123456789012345678901 succeeded!\n", s);
     exit(1);
   }
 
   // clean up
-  unlink("123456789012345/12345678901234");
-  unlink("12345678901234/12345678901234");
-  unlink("12345678901234/12345678901234/12345678901234");
-  unlink("123456789012345/123456789012345/123456789012345");
-  unlink("12345678901234/123456789012345");
-  unlink("12345678901234");
+  unlink("1234567890123456789012345678901/123456789012345678901234567890");
+  unlink("123456789012345678901234567890/123456789012345678901234567890");
+  unlink("123456789012345678901234567890/123456789012345678901234567890/123456789012345678901234567890");
+  unlink("1234567890123456789012345678901/1234567890123456789012345678901/1234567890123456789012345678901");
+  unlink("123456789012345678901234567890/1234567890123456789012345678901");
+  unlink("123456789012345678901234567890");
 }
 
 void
@@ -2040,44 +2383,831 @@ iref(char *s)
   chdir("/");
 }
 
-// test that fork fails gracefully
-// the forktest binary also does this, but it runs out of proc entries first.
-// inside the bigger usertests binary, we run out of memory first.
+// hold open more distinct inodes at once than the original
+// fixed-size inode table (NINODE) had room for.
 void
-forktest(char *s)
+manyinodes(char *s)
 {
-  enum{ N = 1000 };
-  int n, pid;
+  enum { NCHILD = 8, NF = 10 };
+  int ready[2], go[2], i, j, n, pid, xstatus;
+  char name[8], c;
 
-  for(n=0; n<N; n++){
+  if(pipe(ready) < 0 || pipe(go) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  name[0] = 'm';
+  name[1] = 'i';
+  name[4] = 0;
+  for(i = 0; i < NCHILD; i++){
     pid = fork();
-    if(pid < 0)
-      break;
-    if(pid == 0)
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      close(ready[0]);
+      close(go[1]);
+      name[2] = '0' + i;
+      for(j = 0; j < NF; j++){
+        name[3] = '0' + j;
+        if(open(name, O_CREATE|O_RDWR) < 0)
+          exit(1);
+      }
+      write(ready[1], "x", 1);
+      // wait until the parent has seen every child's files open.
+      read(go[0], &c, 1);
+      for(j = 0; j < NF; j++){
+        name[3] = '0' + j;
+        unlink(name);
+      }
       exit(0);
+    }
   }
-
-  if (n == 0) {
-    printf("%s: no fork at all!\n", s);
+  close(ready[1]);
+  close(go[0]);
+  for(n = 0; n < NCHILD && read(ready[0], &c, 1) == 1; n++)
+    ;
+  close(ready[0]);
+  close(go[1]);
+  for(i = 0; i < NCHILD; i++){
+    wait(&xstatus);
+    if(xstatus != 0){
+      printf("%s: child failed to open its files\n", s);
+      exit(1);
+    }
+  }
+  if(n != NCHILD){
+    printf("%s: only %d children opened their files\n", s, n);
     exit(1);
   }
+}
 
-  if(n == N){
-    printf("%s: fork claimed to work 1000 times!\n", s);
+// run open/write/close/read through the system call ring.
+void
+ringtest(char *s)
+{
+  char buf[16];
+  uint64 data;
+  int fd, res, n;
+
+  unlink("ringfile");
+  if(ringinit() < 0){
+    printf("%s: ringinit failed\n", s);
+    exit(1);
+  }
+  if(ringopen("ringfile", O_CREATE|O_RDWR, 1) < 0 || ringsubmit() != 1 ||
+     ringreap(&data, &fd) < 0 || data != 1 || fd < 0){
+    printf("%s: ring open failed\n", s);
+    exit(1);
+  }
+  ringwrite(fd, "ring!", 5, 2);
+  ringclose(fd, 3);
+  ringopen("ringfile", O_RDONLY, 4);
+  if((n = ringsubmit()) != 3){
+    printf("%s: ringsubmit returned %d, not 3\n", s, n);
+    exit(1);
+  }
+  for(n = 2; n <= 4; n++){
+    if(ringreap(&data, &res) < 0 || data != n){
+      printf("%s: completions out of order\n", s);
+      exit(1);
+    }
+    if((n == 2 && res != 5) || (n == 3 && res != 0) || (n == 4 && res < 0)){
+      printf("%s: op %d returned %d\n", s, n, res);
+      exit(1);
+    }
+  }
+  fd = res;
+  ringread(fd, buf, sizeof(buf), 5);
+  ringclose(fd, 6);
+  ringclose(fd, 7);
+  if(ringsubmit() != 3){
+    printf("%s: ringsubmit failed\n", s);
+    exit(1);
+  }
+  if(ringreap(&data, &res) < 0 || res != 5 || memcmp(buf, "ring!", 5) != 0){
+    printf("%s: ring read returned %d\n", s, res);
+    exit(1);
+  }
+  if(ringreap(0, &res) < 0 || res != 0 || ringreap(0, &res) < 0 || res != -1){
+    printf("%s: ring close results wrong\n", s);
+    exit(1);
+  }
+  if(ringreap(0, 0) != -1){
+    printf("%s: extra completion\n", s);
     exit(1);
   }
+  unlink("ringfile");
+}
 
-  for(; n > 0; n--){
-    if(wait(0) < 0){
-      printf("%s: wait stopped early\n", s);
+// the name lookup cache must answer repeated lookups, and
+// must notice names that are created, removed, or whose
+// directory goes away.
+void
+dcachetest(char *s)
+{
+  struct dcachestat st0, st1;
+  int fd, i;
+
+  unlink("dcd/f");
+  unlink("dcd");
+  if(mkdir("dcd") < 0){
+    printf("%s: mkdir dcd failed\n", s);
+    exit(1);
+  }
+  if(dcachestat(&st0) < 0){
+    printf("%s: dcachestat failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 10; i++){
+    if(open("dcd/f", O_RDONLY) >= 0){
+      printf("%s: opened dcd/f before creating it\n", s);
+      exit(1);
+    }
+  }
+  if((fd = open("dcd/f", O_CREATE|O_WRONLY)) < 0){
+    printf("%s: create dcd/f failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  for(i = 0; i < 10; i++){
+    if((fd = open("dcd/f", O_RDONLY)) < 0){
+      printf("%s: open dcd/f failed after create\n", s);
       exit(1);
     }
+    close(fd);
+  }
+  dcachestat(&st1);
+  if(st1.hits - st0.hits < 10 || st1.neghits - st0.neghits < 9){
+    printf("%s: repeated lookups missed the cache\n", s);
+    exit(1);
   }
 
-  if(wait(0) != -1){
-    printf("%s: wait got too many\n", s);
+  if(unlink("dcd/f") < 0){
+    printf("%s: unlink dcd/f failed\n", s);
+    exit(1);
+  }
+  if(open("dcd/f", O_RDONLY) >= 0){
+    printf("%s: opened dcd/f after unlink\n", s);
     exit(1);
   }
+  if((fd = open("dcd/f", O_CREATE|O_WRONLY)) < 0){
+    printf("%s: re-create dcd/f failed\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("dcd/f");
+
+  // a new directory that reuses dcd's inode must start empty.
+  if(unlink("dcd") < 0 || mkdir("dcd") < 0){
+    printf("%s: re-making dcd failed\n", s);
+    exit(1);
+  }
+  if(open("dcd/f", O_RDONLY) >= 0){
+    printf("%s: stale name in new dcd\n", s);
+    exit(1);
+  }
+  unlink("dcd");
+}
+
+// buffered printf() output to a file must all arrive, once,
+// across fork() and exit(); fgets() must read it back by line.
+void
+stdiotest(char *s)
+{
+  enum { N = 100 };
+  char buf[32], want[32];
+  int i, pid, xstatus;
+
+  unlink("stdiof");
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    close(1);
+    if(open("stdiof", O_CREATE|O_WRONLY) != 1)
+      exit(1);
+    for(i = 0; i < N; i++){
+      printf("line %d\n", i);
+      if(i == N/2 && fork() == 0)
+        exit(0);   // must not write the parent's buffer again
+    }
+    wait(0);
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: child failed\n", s);
+    exit(1);
+  }
+
+  pid = fork();
+  if(pid == 0){
+    close(0);
+    if(open("stdiof", O_RDONLY) != 0)
+      exit(1);
+    for(i = 0; i < N; i++){
+      fgets(0, buf, sizeof(buf));
+      strcpy(want, "line ");
+      if(i < 10){
+        want[5] = '0' + i;
+        want[6] = '\n';
+        want[7] = 0;
+      } else {
+        want[5] = '0' + i/10;
+        want[6] = '0' + i%10;
+        want[7] = '\n';
+        want[8] = 0;
+      }
+      if(strcmp(buf, want) != 0)
+        exit(1);
+    }
+    fgets(0, buf, sizeof(buf));
+    exit(buf[0] == 0 ? 0 : 1);
+  }
+  wait(&xstatus);
+  if(xstatus != 0){
+    printf("%s: wrong output in stdiof\n", s);
+    exit(1);
+  }
+  unlink("stdiof");
+}
+
+// lockstat() must report the counters for the kernel's locks,
+// and they must grow as the locks are used.
+void
+lockstattest(char *s)
+{
+  struct lockstat st[32];
+  uint64 before = 0;
+  int n, i, found = 0;
+
+  n = lockstat(st, 32);
+  if(n <= 0 || n > 32){
+    printf("%s: lockstat returned %d\n", s, n);
+    exit(1);
+  }
+  for(i = 0; i < n; i++)
+    if(strcmp(st[i].name, "kmem") == 0)
+      before = st[i].nacquire;
+  sbrk(4096);
+  sbrk(-4096);
+  n = lockstat(st, 32);
+  for(i = 0; i < n; i++){
+    if(strcmp(st[i].name, "kmem") == 0){
+      found = 1;
+      if(st[i].nlocks != 1 || st[i].nacquire <= before){
+        printf("%s: kmem counters did not grow\n", s);
+        exit(1);
+      }
+    }
+  }
+  if(!found){
+    printf("%s: no counters for kmem\n", s);
+    exit(1);
+  }
+  if(lockstat(st, 0) != 0){
+    printf("%s: lockstat(st, 0) != 0\n", s);
+    exit(1);
+  }
+}
+
+// %l must print all 64 bits: lockstat, scstat, and the
+// rest print counters that pass 2^32.
+void
+printlong(char *s)
+{
+  char buf[32];
+  int fd, n;
+
+  fd = open("printlong", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  fprintf(fd, "%l %d", 5000000000ULL, -7);
+  close(fd);
+  fd = open("printlong", O_RDONLY);
+  n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  unlink("printlong");
+  if(n < 0)
+    n = 0;
+  buf[n] = 0;
+  if(strcmp(buf, "5000000000 -7") != 0){
+    printf("%s: printed \"%s\"\n", s, buf);
+    exit(1);
+  }
+}
+
+// memory from a big aligned sbrk() (megapages) must survive
+// fork, system calls, and shrinking to a size that splits
+// a megapage.
+void
+megapage(char *s)
+{
+  enum { SIZE = 4*1024*1024 };
+  char *top, *p;
+  int i, pad, fds[2], pid, xstatus;
+
+  top = sbrk(0);
+  pad = MEGAPGSIZE - (uint64)top % MEGAPGSIZE;
+  if(sbrk(pad) == (char*)-1 || (p = sbrk(SIZE)) == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < SIZE; i += PGSIZE)
+    p[i] = i / PGSIZE;
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    for(i = 0; i < SIZE; i += PGSIZE){
+      if(p[i] != (char)(i / PGSIZE)){
+        printf("%s: child sees wrong byte at %d\n", s, i);
+        exit(1);
+      }
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(1);
+
+  // the kernel must reach megapage memory for read and write.
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(write(fds[1], p + MEGAPGSIZE, 100) != 100 ||
+     read(fds[0], p + 3*PGSIZE, 100) != 100 ||
+     p[3*PGSIZE] != (char)(MEGAPGSIZE / PGSIZE)){
+    printf("%s: pipe through megapage failed\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  // keep the first megapage and a half.
+  sbrk(-(MEGAPGSIZE + MEGAPGSIZE/2));
+  for(i = MEGAPGSIZE; i < MEGAPGSIZE + MEGAPGSIZE/2; i += PGSIZE){
+    if(p[i] != (char)(i / PGSIZE)){
+      printf("%s: wrong byte at %d after shrink\n", s, i);
+      exit(1);
+    }
+  }
+  sbrk(-(MEGAPGSIZE + MEGAPGSIZE/2 + pad));
+  if(sbrk(0) != top){
+    printf("%s: break not restored\n", s);
+    exit(1);
+  }
+}
+
+// memstat() must count free memory consistently, and the
+// buddy allocator must get it all back after a big sbrk().
+void
+memstattest(char *s)
+{
+  struct memstat st0, st1;
+  uint64 n;
+  int i;
+
+  if(memstat(&st0) < 0){
+    printf("%s: memstat failed\n", s);
+    exit(1);
+  }
+  n = 0;
+  for(i = 0; i <= MAXORDER; i++)
+    n += (uint64)st0.nblock[i] << i;
+  if(n != st0.nfree || st0.nfree > st0.npage){
+    printf("%s: inconsistent counts\n", s);
+    exit(1);
+  }
+  if(sbrk(1024*4096) == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  memstat(&st1);
+  if(st1.nfree + 1024 > st0.nfree){
+    printf("%s: sbrk took only %l pages\n", s, st0.nfree - st1.nfree);
+    exit(1);
+  }
+  sbrk(-1024*4096);
+  memstat(&st1);
+  if(st1.nfree + 8 < st0.nfree){
+    printf("%s: lost %l pages\n", s, st0.nfree - st1.nfree);
+    exit(1);
+  }
+}
+
+// pipes and open files come from kernel object caches, whose
+// statistics must account for every object, and the number
+// of open files must not be limited by a fixed-size table.
+void
+slabtest(char *s)
+{
+  struct slabstat st[24];
+  int n, i, pipen = -1, filen = -1;
+  int fds[2], pid, xstatus;
+  uint64 before;
+
+  n = slabstat(st, 24);
+  if(n <= 0 || n > 24){
+    printf("%s: slabstat returned %d\n", s, n);
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    if(strcmp(st[i].name, "pipe") == 0)
+      pipen = i;
+    if(strcmp(st[i].name, "file") == 0)
+      filen = i;
+  }
+  if(pipen < 0 || filen < 0){
+    printf("%s: no pipe or file cache\n", s);
+    exit(1);
+  }
+  before = st[pipen].nalloc;
+  for(i = 0; i < 20; i++){
+    if(pipe(fds) < 0){
+      printf("%s: pipe failed\n", s);
+      exit(1);
+    }
+    close(fds[0]);
+    close(fds[1]);
+  }
+  slabstat(st, 24);
+  if(st[pipen].nalloc < before + 20 || st[pipen].nfree > st[pipen].nalloc){
+    printf("%s: pipe cache counters wrong\n", s);
+    exit(1);
+  }
+
+  // more open files than the old 100-entry table held,
+  // spread over several processes.
+  for(i = 0; i < 10; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      int j;
+      for(j = 0; j < 6; j++){
+        if(pipe(fds) < 0){
+          printf("%s: pipe %d failed\n", s, j);
+          exit(1);
+        }
+      }
+      sleep(5);
+      exit(0);
+    }
+  }
+  for(i = 0; i < 10; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+}
+
+// a process can use more memory than is free, with the
+// excess paged out to swap and read back when touched.
+void
+swaptest(char *s)
+{
+  struct memstat st0, st1;
+  uint64 i, n;
+  char *a;
+  int pid, xstatus;
+
+  if(memstat(&st0) < 0){
+    printf("%s: memstat failed\n", s);
+    exit(1);
+  }
+  if(st0.nswap == 0)
+    return;  // no swap, e.g. with the ramdisk
+  n = (st0.nfree + 1024 + 255) / 256 * 256;
+  if((uint64)sbrk(0) + n*4096 > MAXUSER)
+    return;  // more memory free than one process may have
+
+  pid = fork();
+  if(pid < 0){
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid == 0){
+    a = sbrk(0);
+    // a megabyte at a time, so none of it is in megapages.
+    for(i = 0; i < n; i += 256){
+      if(sbrk(256*4096) == (char*)-1){
+        printf("%s: sbrk failed after %d pages\n", s, i);
+        exit(1);
+      }
+    }
+    for(i = 0; i < n; i++)
+      *(uint64*)(a + i*4096) = i;
+    for(i = 0; i < n; i += 16){
+      if(*(uint64*)(a + i*4096) != i){
+        printf("%s: page %d has the wrong content\n", s, i);
+        exit(1);
+      }
+    }
+    memstat(&st1);
+    if(st1.pageout == st0.pageout || st1.pagein == st0.pagein){
+      printf("%s: nothing went through swap\n", s);
+      exit(1);
+    }
+    exit(0);
+  }
+  wait(&xstatus);
+  if(xstatus != 0)
+    exit(xstatus);
+}
+
+// processes reading, stat()ing, and looking up the same
+// file at once, under shared inode and buffer locks,
+// must all see its whole content.
+void
+sharedread(char *s)
+{
+  enum { NCHILD = 4, NBLK = 20, ROUNDS = 10 };
+  static char buf[BSIZE];
+  struct stat st;
+  int fd, i, j, b, pid, xstatus;
+
+  unlink("sharedf");
+  if((fd = open("sharedf", O_CREATE|O_WRONLY)) < 0){
+    printf("%s: create sharedf failed\n", s);
+    exit(1);
+  }
+  for(b = 0; b < NBLK; b++){
+    memset(buf, 'a' + b, sizeof(buf));
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf("%s: write sharedf failed\n", s);
+      exit(1);
+    }
+  }
+  close(fd);
+
+  for(i = 0; i < NCHILD; i++){
+    pid = fork();
+    if(pid < 0){
+      printf("%s: fork failed\n", s);
+      exit(1);
+    }
+    if(pid == 0){
+      for(j = 0; j < ROUNDS; j++){
+        if((fd = open("sharedf", O_RDONLY)) < 0)
+          exit(1);
+        if(fstat(fd, &st) < 0 || st.size != NBLK*BSIZE)
+          exit(1);
+        for(b = 0; b < NBLK; b++){
+          if(read(fd, buf, sizeof(buf)) != sizeof(buf))
+            exit(1);
+          if(buf[0] != 'a' + b || buf[BSIZE-1] != 'a' + b)
+            exit(1);
+        }
+        close(fd);
+      }
+      exit(0);
+    }
+  }
+  for(i = 0; i < NCHILD; i++){
+    wait(&xstatus);
+    if(xstatus != 0){
+      printf("%s: a reader saw the wrong content\n", s);
+      exit(1);
+    }
+  }
+  unlink("sharedf");
+}
+
+// files in the tmpfs that init mounts on /tmp: content
+// spanning pages, subdirectories, ".." out of the mount,
+// and no links across it.
+void
+tmpfstest(char *s)
+{
+  enum { N = 3*4096 + 100 };
+  static char buf[N];
+  struct stat st, rootst;
+  int fd, i;
+
+  if(stat("/tmp", &st) < 0 || stat("/", &rootst) < 0 || st.dev == rootst.dev){
+    printf("%s: /tmp isn't a separate file system\n", s);
+    exit(1);
+  }
+  unlink("/tmp/td/f");
+  unlink("/tmp/td");
+  if(mkdir("/tmp/td") < 0){
+    printf("%s: mkdir /tmp/td failed\n", s);
+    exit(1);
+  }
+  if((fd = open("/tmp/td/f", O_CREATE|O_RDWR)) < 0){
+    printf("%s: create /tmp/td/f failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < N; i++)
+    buf[i] = i % 251;
+  if(write(fd, buf, N) != N){
+    printf("%s: write /tmp/td/f failed\n", s);
+    exit(1);
+  }
+  close(fd);
+
+  if(chdir("/tmp/td") < 0){
+    printf("%s: chdir /tmp/td failed\n", s);
+    exit(1);
+  }
+  memset(buf, 0, N);
+  if((fd = open("../../tmp/td/f", O_RDONLY)) < 0){
+    printf("%s: open via .. failed\n", s);
+    exit(1);
+  }
+  if(read(fd, buf, N) != N || read(fd, buf, 1) != 0){
+    printf("%s: read /tmp/td/f wrong length\n", s);
+    exit(1);
+  }
+  close(fd);
+  for(i = 0; i < N; i++){
+    if(buf[i] != (char)(i % 251)){
+      printf("%s: wrong content at %d\n", s, i);
+      exit(1);
+    }
+  }
+  if(chdir("/") < 0){
+    printf("%s: chdir / failed\n", s);
+    exit(1);
+  }
+
+  if(link("/tmp/td/f", "tmplink") == 0){
+    printf("%s: link across file systems succeeded\n", s);
+    exit(1);
+  }
+  if(unlink("/tmp") == 0){
+    printf("%s: unlinked the mount point\n", s);
+    exit(1);
+  }
+  if(unlink("/tmp/td") == 0){
+    printf("%s: unlinked non-empty /tmp/td\n", s);
+    exit(1);
+  }
+  if(unlink("/tmp/td/f") < 0 || unlink("/tmp/td") < 0){
+    printf("%s: unlink in /tmp failed\n", s);
+    exit(1);
+  }
+  if(open("/tmp/td/f", O_RDONLY) >= 0){
+    printf("%s: /tmp/td/f still there\n", s);
+    exit(1);
+  }
+}
+
+// the profiler must sample a process that spins in user space,
+// and hand each sample out only once.
+void
+proftest(char *s)
+{
+  static struct profsample buf[64];
+  int n, i, t0, mine = 0;
+  volatile int x = 0;
+
+  if(prof(PROF_START, 0, 0) < 0){
+    printf("%s: prof start failed\n", s);
+    exit(1);
+  }
+  t0 = uptime();
+  while(uptime() - t0 < 3)
+    x++;
+  prof(PROF_STOP, 0, 0);
+
+  while((n = prof(PROF_READ, buf, 64)) > 0){
+    for(i = 0; i < n; i++)
+      if(buf[i].user && buf[i].pid == getpid() && buf[i].pc < (uint64)sbrk(0))
+        mine++;
+  }
+  if(n < 0){
+    printf("%s: prof read failed\n", s);
+    exit(1);
+  }
+  if(mine == 0){
+    printf("%s: no samples of this process\n", s);
+    exit(1);
+  }
+  if(prof(PROF_READ, buf, 64) != 0){
+    printf("%s: samples read twice\n", s);
+    exit(1);
+  }
+}
+
+// syscallstat() must count calls system-wide and per process.
+void
+scstattest(char *s)
+{
+  struct syscallstat st0, st1, mine;
+  int i;
+
+  if(syscallstat(SYS_getpid, 0, &st0) < 0){
+    printf("%s: syscallstat failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 10; i++)
+    getpid();
+  if(syscallstat(SYS_getpid, 0, &st1) < 0 ||
+     syscallstat(SYS_getpid, getpid(), &mine) < 0){
+    printf("%s: syscallstat failed\n", s);
+    exit(1);
+  }
+  if(strcmp(st1.name, "getpid") != 0){
+    printf("%s: wrong name %s\n", s, st1.name);
+    exit(1);
+  }
+  if(st1.count < st0.count + 10 || mine.count < 10){
+    printf("%s: getpid calls not counted\n", s);
+    exit(1);
+  }
+  if(syscallstat(0, 0, &st0) != -1 || syscallstat(SYS_getpid, -1, &st0) != -1){
+    printf("%s: syscallstat accepted bad arguments\n", s);
+    exit(1);
+  }
+}
+
+// test that fork fails gracefully
+// the forktest binary also does this, but it runs out of proc entries first.
+// inside the bigger usertests binary, we run out of memory first.
+void
+forktest(char *s)
+{
+  enum{ N = NPROC + 1 };
+  int n, pid;
+
+  for(n=0; n<N; n++){
+    pid = fork();
+    if(pid < 0)
+      break;
+    if(pid == 0)
+      exit(0);
+  }
+
+  if (n == 0) {
+    printf("%s: no fork at all!\n", s);
+    exit(1);
+  }
+
+  if(n == N){
+    printf("%s: fork claimed to work %d times!\n", s, N);
+    exit(1);
+  }
+
+  for(; n > 0; n--){
+    if(wait(0) < 0){
+      printf("%s: wait stopped early\n", s);
+      exit(1);
+    }
+  }
+
+  if(wait(0) != -1){
+    printf("%s: wait got too many\n", s);
+    exit(1);
+  }
+}
+
+// the process table isn't fixed at 64 entries: that
+// many children and more can all be alive at once.
+void
+manyprocs(char *s)
+{
+  enum { N = 200 };
+  int i, pid, fds[2];
+  char c;
+
+  if(pipe(fds) < 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < N; i++){
+    if((pid = fork()) < 0){
+      printf("%s: fork %d failed\n", s, i);
+      exit(1);
+    }
+    if(pid == 0){
+      // wait for the parent to close the pipe.
+      close(fds[1]);
+      read(fds[0], &c, 1);
+      exit(0);
+    }
+  }
+  close(fds[0]);
+  close(fds[1]);
+  for(i = 0; i < N; i++){
+    if(wait(0) < 0){
+      printf("%s: wait stopped early\n", s);
+      exit(1);
+    }
+  }
 }
 
 void
@@ -2849,7 +3979,11 @@ main(int argc, char *argv[])
     {fourfiles, "fourfiles"},
     {sharedfd, "sharedfd"},
     {dirtest, "dirtest"},
+    {hashdir, "hashdir"},
     {exectest, "exectest"},
+    {spawntest, "spawntest"},
+    {waitpidtest, "waitpidtest"},
+    {shstdin, "shstdin"},
     {bigargtest, "bigargtest"},
     {bigwrite, "bigwrite"},
     {bsstest, "bsstest"},
@@ -2870,17 +4004,34 @@ main(int argc, char *argv[])
     {exitiputtest, "exitiput"},
     {iputtest, "iput"},
     {mem, "mem"},
+    {malloctest, "malloctest"},
     {pipe1, "pipe1"},
     {killstatus, "killstatus"},
     {preempt, "preempt"},
     {exitwait, "exitwait"},
     {rmdot, "rmdot"},
-    {fourteen, "fourteen"},
+    {thirty, "thirty"},
     {bigfile, "bigfile"},
     {dirfile, "dirfile"},
     {iref, "iref"},
+    {manyinodes, "manyinodes"},
     {forktest, "forktest"},
+    {manyprocs, "manyprocs"},
+    {ringtest, "ringtest"},
+    {dcachetest, "dcachetest"},
+    {stdiotest, "stdiotest"},
+    {lockstattest, "lockstattest"},
+    {printlong, "printlong"},
+    {slabtest, "slabtest"},
+    {memstattest, "memstattest"},
+    {megapage, "megapage"},
+    {swaptest, "swaptest"},
+    {sharedread, "sharedread"},
+    {tmpfstest, "tmpfstest"},
+    {proftest, "proftest"},
+    {scstattest, "scstattest"},
     {bigdir, "bigdir"}, // slow
+    {manyfiles, "manyfiles"}, // slow
     { 0, 0},
   };
 
@@ -6,24 +6,27 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry(name[, symbol]): the stub for system call name,
+# called symbol if given (for ulib.c wrappers).
 sub entry {
     my $name = shift;
-    print ".global $name\n";
-    print "${name}:\n";
+    my $sym = shift || $name;
+    print ".global $sym\n";
+    print "${sym}:\n";
     print " li a7, SYS_${name}\n";
     print " ecall\n";
     print " ret\n";
 }
 	
-entry("fork");
-entry("exit");
+entry("fork", "_fork");
+entry("exit", "_exit");
 entry("wait");
 entry("pipe");
 entry("read");
 entry("write");
-entry("close");
+entry("close", "_close");
 entry("kill");
-entry("exec");
+entry("exec", "_exec");
 entry("open");
 entry("mknod");
 entry("unlink");
@@ -36,3 +39,14 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("ringsetup");
+entry("ringenter");
+entry("dcachestat");
+entry("lockstat");
+entry("mount");
+entry("prof");
+entry("syscallstat");
+entry("slabstat");
+entry("memstat");
+entry("spawn", "_spawn");
+entry("waitpid");